@@ -0,0 +1,128 @@
+#include "contenthash.h"
+
+#include <cstring>
+
+namespace gutils {
+
+namespace {
+constexpr size_t kStripesPerBlock = 16;
+constexpr uint64_t kPrime32 = 0x9E3779B1u;
+constexpr uint64_t kPrime64a = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kPrime64b = 0xC2B2AE3D27D4EB4Full;
+
+// the keys: 8 per stripe at a sliding offset (0..15), then scramble, low and high digest
+constexpr size_t kStripeKeys = 0;
+constexpr size_t kScrambleKeys = 24;
+constexpr size_t kLoKeys = 32;
+constexpr size_t kHiKeys = 40;
+constexpr size_t kKeyCount = 48;
+
+struct Keys {
+  uint64_t k[kKeyCount];
+};
+
+// splitmix64 from a fixed seed, any well mixed constants do
+constexpr Keys make_keys() {
+  Keys keys{};
+  uint64_t x = 0x243F6A8885A308D3ull;
+  for (size_t i = 0; i < kKeyCount; ++i) {
+    x += 0x9E3779B97F4A7C15ull;
+    uint64_t z = x;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    keys.k[i] = z ^ (z >> 31);
+  }
+  return keys;
+}
+constexpr Keys kKeys = make_keys();
+
+inline uint64_t read64(const unsigned char* p) {
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline void accumulate(uint64_t* acc, const unsigned char* p, const uint64_t* key) {
+  for (size_t i = 0; i < 8; ++i) {
+    uint64_t v = read64(p + 8 * i);
+    uint64_t k = v ^ key[i];
+    acc[i ^ 1] += v;
+    acc[i] += (k & 0xFFFFFFFFu) * (k >> 32);
+  }
+}
+
+inline void scramble(uint64_t* acc) {
+  const uint64_t* key = kKeys.k + kScrambleKeys;
+  for (size_t i = 0; i < 8; ++i) {
+    acc[i] ^= acc[i] >> 47;
+    acc[i] ^= key[i];
+    acc[i] *= kPrime32;
+  }
+}
+
+__extension__ typedef unsigned __int128 uint128;
+
+inline uint64_t mul_fold(uint64_t a, uint64_t b) {
+  uint128 p = static_cast<uint128>(a) * b;
+  return static_cast<uint64_t>(p) ^ static_cast<uint64_t>(p >> 64);
+}
+
+inline uint64_t avalanche(uint64_t h) {
+  h ^= h >> 37;
+  h *= 0x165667919E3779F9ull;
+  return h ^ (h >> 32);
+}
+
+uint64_t fold(const uint64_t* acc, const uint64_t* key, uint64_t seed) {
+  uint64_t h = seed;
+  for (size_t i = 0; i < 8; i += 2) h += mul_fold(acc[i] ^ key[i], acc[i + 1] ^ key[i + 1]);
+  return avalanche(h);
+}
+}
+
+ContentHash::ContentHash()
+    : acc_{kPrime32, kPrime64a, kPrime64b, 0x165667B19E3779F9ull,
+           0x85EBCA77C2B2AE63ull, 0x27D4EB2F165667C5ull, kPrime64a ^ kPrime64b, 0x61C8864E7A143579ull} {}
+
+void ContentHash::stripe(const unsigned char* p) {
+  accumulate(acc_, p, kKeys.k + kStripeKeys + stripes_);
+  if (++stripes_ == kStripesPerBlock) {
+    scramble(acc_);
+    stripes_ = 0;
+  }
+}
+
+void ContentHash::update(const void* data, size_t n) {
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  total_ += n;
+  if (buf_len_ > 0) {
+    size_t take = n < kStripe - buf_len_ ? n : kStripe - buf_len_;
+    std::memcpy(buf_ + buf_len_, p, take);
+    buf_len_ += take;
+    p += take;
+    n -= take;
+    if (buf_len_ < kStripe) return;
+    stripe(buf_);
+    buf_len_ = 0;
+  }
+  for (; n >= kStripe; p += kStripe, n -= kStripe) stripe(p);
+  std::memcpy(buf_, p, n);
+  buf_len_ = n;
+}
+
+Digest128 ContentHash::digest() const {
+  uint64_t acc[kLanes];
+  std::memcpy(acc, acc_, sizeof(acc));
+  if (buf_len_ > 0) {
+    // zero padded, the length below tells "a" from "a\0"
+    unsigned char last[kStripe] = {};
+    std::memcpy(last, buf_, buf_len_);
+    accumulate(acc, last, kKeys.k + kStripeKeys + stripes_);
+  }
+  Digest128 d;
+  d.lo = fold(acc, kKeys.k + kLoKeys, total_ * kPrime64a);
+  d.hi = fold(acc, kKeys.k + kHiKeys, ~total_ * kPrime64b);
+  return d;
+}
+
+}
@@ -0,0 +1,45 @@
+#ifndef CONTENTHASH_H_
+#define CONTENTHASH_H_
+// A fast non cryptographic 128 bit hash of file contents, for --dedupe.
+// The layout is that of XXH3's long input loop, the digests are not XXH3's. The input goes in
+// 64 byte stripes into eight 64 bit lanes, one 32x32->64 multiply and two adds per lane. The
+// lanes do not depend on each other, so the compiler turns a stripe into a few vector multiplies
+// (pmuludq with SSE2/AVX2). Every 1 KiB the lanes are scrambled so no input difference cancels
+// out, the digest folds them down with full 64x64->128 multiplies.
+// Equal contents give equal digests within one build; nothing else is promised.
+#include <cstddef>
+#include <cstdint>
+
+namespace gutils {
+
+struct Digest128 {
+  uint64_t lo = 0;
+  uint64_t hi = 0;
+
+  bool operator==(const Digest128& o) const { return lo == o.lo && hi == o.hi; }
+  bool operator!=(const Digest128& o) const { return !(*this == o); }
+};
+
+class ContentHash {
+public:
+  ContentHash();
+
+  void update(const void* data, size_t n);
+  // the digest of everything passed to update() so far
+  Digest128 digest() const;
+
+private:
+  static constexpr size_t kLanes = 8;
+  static constexpr size_t kStripe = 64;
+
+  void stripe(const unsigned char* p);
+
+  uint64_t acc_[kLanes];
+  unsigned char buf_[kStripe];  // the start of a stripe that update() has not completed yet
+  size_t buf_len_ = 0;
+  size_t stripes_ = 0;          // stripes since the last scramble
+  uint64_t total_ = 0;
+};
+
+}
+#endif // CONTENTHASH_H_
@@ -0,0 +1,128 @@
+#include "contentmatcher.h"
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace gutils {
+
+namespace {
+bool is_regex_syntax(char c) {
+  return std::strchr(".^$|()[]{}*+?\\", c) != nullptr;
+}
+
+bool find_literal(std::string_view hay, std::string_view lit) {
+  if (lit.size() > hay.size()) return false;
+  const char* p = hay.data();
+  const char* end = hay.data() + hay.size() - lit.size() + 1;  // last possible start + 1
+  while (p < end) {
+    p = static_cast<const char*>(std::memchr(p, lit[0], end - p));
+    if (p == nullptr) return false;
+    if (std::memcmp(p + 1, lit.data() + 1, lit.size() - 1) == 0) return true;
+    ++p;
+  }
+  return false;
+}
+
+bool is_binary(std::string_view data) {
+  size_t n = std::min(data.size(), ContentMatcher::kBinaryProbe);
+  return std::memchr(data.data(), '\0', n) != nullptr;
+}
+
+struct Fd {
+  int fd;
+  ~Fd() { if (fd >= 0) ::close(fd); }
+};
+}
+
+ContentMatcher::ContentMatcher(std::string_view pattern) {
+  bool literal = !pattern.empty();
+  for (char c : pattern) {
+    if (is_regex_syntax(c)) {
+      literal = false;
+      break;
+    }
+  }
+  if (literal) {
+    literal_ = std::string(pattern);
+    return;
+  }
+  RE2::Options opts;
+  opts.set_log_errors(false);
+  // (?m): grep-like ^ and $
+  regex_ = std::make_unique<RE2>("(?m)" + std::string(pattern), opts);
+}
+
+bool ContentMatcher::matches(std::string_view data) const {
+  return matches(data, 0, data.size());
+}
+
+bool ContentMatcher::matches(std::string_view data, size_t begin, size_t end) const {
+  if (!regex_) return find_literal(data.substr(begin, end - begin), literal_);
+  return regex_->Match(data, begin, end, RE2::UNANCHORED, nullptr, 0);
+}
+
+size_t ContentMatcher::carry(std::string_view data) const {
+  if (!regex_) return std::min(data.size(), literal_.size() - 1);
+  size_t nl = data.rfind('\n');
+  size_t line = nl == std::string_view::npos ? data.size() : data.size() - nl;
+  return line > kMaxCarry ? 0 : line;
+}
+
+bool ContentMatcher::file_matches(const char* path, int& err) const {
+  err = 0;
+  // O_NONBLOCK: a FIFO that got past the type checks (--follow, a type change since) must not
+  // block the worker in open() or read(). regular files ignore it
+  Fd f{::open(path, O_RDONLY | O_CLOEXEC | O_NONBLOCK)};
+  if (f.fd < 0) {
+    err = errno;
+    return false;
+  }
+  struct stat st;
+  if (::fstat(f.fd, &st) != 0) {
+    err = errno;
+    return false;
+  }
+  if (!S_ISREG(st.st_mode) || st.st_size == 0) return false;
+
+  thread_local std::vector<char> buf;
+  size_t keep = 0;  // carried over from the previous piece, at the start of buf
+  size_t from = 0;  // 1 when that starts with a newline, context for ^ only
+  off_t off = 0;
+  bool first = true;
+  while (true) {
+    if (buf.size() < keep + kChunk) buf.resize(keep + kChunk);
+    size_t len = keep;
+    while (len < keep + kChunk) {
+      ssize_t n = ::pread(f.fd, buf.data() + len, keep + kChunk - len, off);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        err = errno;
+        return false;
+      }
+      if (n == 0) break;  // the end, or truncated while we read it
+      len += static_cast<size_t>(n);
+      off += n;
+    }
+    std::string_view data(buf.data(), len);
+    if (first && is_binary(data)) return false;
+    first = false;
+    if (len < keep + kChunk) {
+      // the newline that ends the file ends the last line, it does not start an empty one for ^$
+      size_t end = regex_ && len > from && data[len - 1] == '\n' ? len - 1 : len;
+      return end > from && matches(data, from, end);
+    }
+    // not the end: the tail goes to the next piece unsearched, a $, ^$ or \b at the cut would
+    // be a false hit
+    keep = carry(data);
+    if (len - keep > from && matches(data, from, len - keep)) return true;
+    from = regex_ && keep > 0 && data[len - keep] == '\n' ? 1 : 0;
+    std::memmove(buf.data(), buf.data() + len - keep, keep);
+  }
+}
+
+}
@@ -0,0 +1,54 @@
+#ifndef CONTENTMATCHER_H_
+#define CONTENTMATCHER_H_
+// File content search for the fd tools (--contains).
+// A pattern without regex syntax is a plain literal, it is found with memchr on its first byte
+// (glibc's memchr is vectorized) and a memcmp of the rest. Everything else goes through RE2.
+// Only the first match matters, the scan stops there.
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <re2/re2.h>
+
+namespace gutils {
+
+class ContentMatcher {
+public:
+  // files are read into a per-thread buffer this much at a time, a smaller file in one piece.
+  // no mmap: a file truncated by another process while it is searched would SIGBUS, a read just
+  // ends early
+  static constexpr size_t kChunk = 1024 * 1024;
+  // a line that does not fit in this many bytes is searched in pieces, a regex match across the
+  // cut is missed
+  static constexpr size_t kMaxCarry = 16 * kChunk;
+  // a NUL byte in this many leading bytes makes a file binary, like grep does
+  static constexpr size_t kBinaryProbe = 8 * 1024;
+
+  // RE2 syntax, ^ and $ match at line boundaries
+  explicit ContentMatcher(std::string_view pattern);
+
+  bool ok() const { return !regex_ || regex_->ok(); }
+  std::string error() const { return regex_ ? regex_->error() : std::string(); }
+  bool is_literal() const { return !regex_; }
+
+  bool matches(std::string_view data) const;
+
+  // true when the file contains a match. binary files and anything but a regular file never match.
+  // err is set to the errno of a failed open/read and 0 otherwise
+  bool file_matches(const char* path, int& err) const;
+
+private:
+  // a match in data[begin, end). the bytes around it are context only: ^, $ and \b at either
+  // end look at them instead of taking the cut for the start or end of the file
+  bool matches(std::string_view data, size_t begin, size_t end) const;
+
+  // the end of data that is left for the next piece, for a match that would straddle the cut:
+  // a literal's length - 1, or for a regex the unfinished last line with the newline before it
+  size_t carry(std::string_view data) const;
+
+  std::string literal_;
+  std::unique_ptr<RE2> regex_;
+};
+
+}
+#endif // CONTENTMATCHER_H_
@@ -0,0 +1,41 @@
+#include "devinfo.h"
+
+#include <sys/sysmacros.h>
+
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace gutils {
+
+namespace {
+bool read_flag(const fs::path& file, bool& value) {
+  std::ifstream in(file);
+  int v;
+  if (!(in >> v)) return false;
+  value = v != 0;
+  return true;
+}
+}
+
+DeviceInfo device_info(dev_t dev) {
+  DeviceInfo info;
+  info.dev = dev;
+  // major 0 is an anonymous device: NFS, tmpfs, overlay, btrfs subvolumes, ...
+  if (major(dev) == 0) return info;
+
+  std::error_code ec;
+  fs::path link = "/sys/dev/block/" + std::to_string(major(dev)) + ":" + std::to_string(minor(dev));
+  fs::path sys = fs::canonical(link, ec);
+  if (ec) return info;
+  info.block = true;
+  info.name = sys.filename().native();
+  // whole disks and dm/md devices have a queue directory, a partition's is on its parent
+  if (!read_flag(sys / "queue" / "rotational", info.rotational)) {
+    read_flag(sys.parent_path() / "queue" / "rotational", info.rotational);
+  }
+  return info;
+}
+
+}
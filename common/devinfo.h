@@ -0,0 +1,22 @@
+#ifndef DEVINFO_H_
+#define DEVINFO_H_
+// What kind of storage a st_dev is on, from sysfs.
+// Used to size the per-device worker pools of a multi-root search: a spinning disk wants few
+// readers (seeks), an SSD or a network filesystem wants many (queue depth, latency hiding).
+#include <sys/types.h>
+
+#include <string>
+
+namespace gutils {
+
+struct DeviceInfo {
+  dev_t dev = 0;
+  bool block = false;       // backed by a block device. false for NFS, tmpfs, overlay, ...
+  bool rotational = false;  // /sys/block/<disk>/queue/rotational, a partition uses its disk's
+  std::string name;         // e.g. "sda2", "nvme0n1p1", empty when !block
+};
+
+DeviceInfo device_info(dev_t dev);
+
+}
+#endif // DEVINFO_H_
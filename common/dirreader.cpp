@@ -0,0 +1,118 @@
+#include "dirreader.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace gutils {
+
+// layout written by the kernel, glibc only exports it with _GNU_SOURCE on recent versions
+struct linux_dirent64 {
+  ino64_t d_ino;
+  off64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+DirReader::DirReader() : buf_(new char[kBufSize]) {}
+
+DirReader::~DirReader() { close(); }
+
+bool DirReader::open(const char* path) {
+  return open_at(AT_FDCWD, path);
+}
+
+bool DirReader::open_at(int parent_fd, const char* name) {
+  close();
+  // O_NOFOLLOW only for children: the start directory given by the user may be a symlink,
+  // a child is only opened after d_type said it is a real directory
+  int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+  if (parent_fd != AT_FDCWD) flags |= O_NOFOLLOW;
+  fd_ = ::openat(parent_fd, name, flags);
+  if (fd_ < 0) {
+    err_ = errno;
+    return false;
+  }
+  err_ = 0;
+  return true;
+}
+
+void DirReader::close() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  pos_ = len_ = 0;
+}
+
+bool DirReader::fill() {
+  long n;
+  do {
+    n = ::syscall(SYS_getdents64, fd_, buf_.get(), kBufSize);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    err_ = errno;
+    return false;
+  }
+  pos_ = 0;
+  len_ = static_cast<size_t>(n);
+  return n > 0;
+}
+
+bool DirReader::next(DirEntry& entry) {
+  if (fd_ < 0) return false;
+  while (true) {
+    if (pos_ >= len_ && !fill()) return false;
+
+    auto* d = reinterpret_cast<linux_dirent64*>(buf_.get() + pos_);
+    pos_ += d->d_reclen;
+
+    const char* name = d->d_name;
+    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+      continue;
+    }
+    entry.name = std::string_view(name, std::strlen(name));
+    entry.type = d->d_type;
+    entry.ino = d->d_ino;
+    return true;
+  }
+}
+
+namespace {
+unsigned char mode_to_type(mode_t mode) {
+  switch (mode & S_IFMT) {
+  case S_IFDIR: return DT_DIR;
+  case S_IFREG: return DT_REG;
+  case S_IFLNK: return DT_LNK;
+  case S_IFIFO: return DT_FIFO;
+  case S_IFSOCK: return DT_SOCK;
+  case S_IFCHR: return DT_CHR;
+  case S_IFBLK: return DT_BLK;
+  default: return DT_UNKNOWN;
+  }
+}
+}
+
+unsigned char DirReader::resolve_type(const DirEntry& entry) const {
+  if (entry.type != DT_UNKNOWN) return entry.type;
+
+  // name is NUL terminated inside the getdents buffer
+  struct stat st;
+  if (::fstatat(fd_, entry.name.data(), &st, AT_SYMLINK_NOFOLLOW) != 0) return DT_UNKNOWN;
+  return mode_to_type(st.st_mode);
+}
+
+unsigned char DirReader::follow_type(const DirEntry& entry) const {
+  unsigned char type = resolve_type(entry);
+  if (type != DT_LNK) return type;
+  struct stat st;
+  // a dangling link stays DT_LNK
+  if (::fstatat(fd_, entry.name.data(), &st, 0) != 0) return DT_LNK;
+  return mode_to_type(st.st_mode);
+}
+
+}
@@ -0,0 +1,61 @@
+#ifndef DIRREADER_H_
+#define DIRREADER_H_
+// Linux directory reader on top of openat/getdents64.
+// fs::directory_iterator gives one entry per call and entry.is_directory() may stat every entry,
+// on network filesystems that is one extra round trip per file.
+// DirReader reads a whole batch of entries into a big reusable buffer and hands out d_type,
+// so a stat is only needed when the filesystem reports DT_UNKNOWN.
+#include <dirent.h>
+#include <sys/types.h>
+#include <memory>
+#include <string_view>
+
+namespace gutils {
+
+struct DirEntry {
+  std::string_view name;    // points into the reader's buffer, valid until the next next() call
+  unsigned char type;       // DT_DIR, DT_REG, DT_LNK, ... or DT_UNKNOWN
+  ino_t ino;
+};
+
+class DirReader {
+public:
+  static constexpr size_t kBufSize = 256 * 1024;
+
+  DirReader();
+  ~DirReader();
+  DirReader(const DirReader&) = delete;
+  DirReader& operator=(const DirReader&) = delete;
+
+  // open a directory by path, any previously opened directory is closed
+  bool open(const char* path);
+  // open name relative to an already opened directory, no full path needed
+  bool open_at(int parent_fd, const char* name);
+  void close();
+
+  // next entry, "." and ".." are skipped. false at the end of the directory or on error()
+  bool next(DirEntry& entry);
+
+  // d_type of entry, calls fstatat relative to fd() only when it is DT_UNKNOWN.
+  // symlinks are not followed, a link to a directory is DT_LNK
+  unsigned char resolve_type(const DirEntry& entry) const;
+  bool is_dir(const DirEntry& entry) const { return resolve_type(entry) == DT_DIR; }
+  // --follow: the type of what a symlink points to, DT_LNK only for a dangling link
+  unsigned char follow_type(const DirEntry& entry) const;
+
+  int fd() const { return fd_; }
+  // errno of the last failed open/read, 0 if none
+  int error() const { return err_; }
+
+private:
+  bool fill();
+
+  int fd_ = -1;
+  int err_ = 0;
+  std::unique_ptr<char[]> buf_;
+  size_t pos_ = 0;
+  size_t len_ = 0;
+};
+
+}
+#endif // DIRREADER_H_
@@ -0,0 +1,177 @@
+#include "dirwatcher.h"
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace gutils {
+
+namespace {
+// IN_CLOSE_WRITE: a file created empty and written afterwards is looked at again, for --size
+constexpr uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE |
+                                IN_ONLYDIR | IN_DONT_FOLLOW;
+}
+
+std::unique_ptr<DirWatcher> DirWatcher::create(std::string& error) {
+  int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) {
+    error = std::strerror(errno);
+    return nullptr;
+  }
+  return std::unique_ptr<DirWatcher>(new DirWatcher(fd));
+}
+
+DirWatcher::~DirWatcher() { ::close(fd_); }
+
+DirWatcher::Dir* DirWatcher::add(std::string path, const IgnoreStack& ignore, int depth, int fd) {
+  auto dir = std::make_unique<Dir>();
+  dir->ignore = ignore;
+  dir->depth = depth;
+  struct stat st;
+  if (::fstat(fd, &st) == 0) {
+    dir->dev = st.st_dev;
+    dir->ino = st.st_ino;
+    dir->mtime = st.st_mtim;
+  }
+  // the watch goes on before the caller reads the directory, an entry created meanwhile is an event
+  dir->wd = ::inotify_add_watch(fd_, path.c_str(), kWatchMask);
+  int err = dir->wd < 0 ? errno : 0;
+  dir->path = std::move(path);
+
+  std::lock_guard<std::mutex> lock(m_);
+  if (dir->wd >= 0) {
+    by_wd_[dir->wd] = dir.get();
+  } else if (!warned_) {
+    warned_ = true;
+    std::cerr << "Cannot watch " << dir->path << ": " << std::strerror(err)
+              << (err == ENOSPC ? ", unwatched directories are rescanned periodically" : "") << std::endl;
+  }
+  Dir* p = dir.get();
+  auto& slot = by_path_[p->path];
+  if (slot) removed_.push_back(std::move(slot));  // the same path again, the old one is stale
+  slot = std::move(dir);
+  return p;
+}
+
+DirWatcher::Dir* DirWatcher::find(const std::string& path) const {
+  std::lock_guard<std::mutex> lock(m_);
+  auto it = by_path_.find(path);
+  return it == by_path_.end() ? nullptr : it->second.get();
+}
+
+void DirWatcher::remove_tree(const std::string& path, const std::function<void(Dir&)>& gone) {
+  std::vector<std::unique_ptr<Dir>> dropped;
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    auto self = by_path_.find(path);
+    if (self != by_path_.end()) {
+      dropped.push_back(std::move(self->second));
+      by_path_.erase(self);
+    }
+    // "a/..." is not next to "a" in the map, "a-b" sorts in between
+    std::string prefix = path;
+    if (prefix.empty() || prefix.back() != '/') prefix += '/';
+    auto it = by_path_.lower_bound(prefix);
+    while (it != by_path_.end() && it->first.compare(0, prefix.size(), prefix) == 0) {
+      dropped.push_back(std::move(it->second));
+      it = by_path_.erase(it);
+    }
+    for (auto& d : dropped) {
+      if (d->wd >= 0) {
+        auto w = by_wd_.find(d->wd);
+        if (w != by_wd_.end() && w->second == d.get()) by_wd_.erase(w);
+        // fails when the kernel dropped the watch already, the directory is gone
+        ::inotify_rm_watch(fd_, d->wd);
+      }
+    }
+  }
+  for (auto& d : dropped) {
+    gone(*d);
+    d->gone = true;
+    removed_.push_back(std::move(d));
+  }
+}
+
+std::vector<DirWatcher::Dir*> DirWatcher::dirs() const {
+  std::lock_guard<std::mutex> lock(m_);
+  std::vector<Dir*> out;
+  for (const auto& [path, d] : by_path_) out.push_back(d.get());
+  return out;
+}
+
+std::vector<DirWatcher::Dir*> DirWatcher::unwatched() const {
+  std::lock_guard<std::mutex> lock(m_);
+  std::vector<Dir*> out;
+  for (const auto& [path, d] : by_path_) {
+    if (d->wd < 0) out.push_back(d.get());
+  }
+  return out;
+}
+
+void DirWatcher::read_events(Batch& batch, std::map<std::pair<Dir*, std::string>, size_t>& index,
+                             std::unordered_map<uint32_t, size_t>& moved_from) {
+  alignas(struct inotify_event) char buf[64 * 1024];
+  while (true) {
+    ssize_t len = ::read(fd_, buf, sizeof(buf));
+    if (len <= 0) return;  // EAGAIN: nothing more for now
+    for (ssize_t off = 0; off < len;) {
+      auto* ev = reinterpret_cast<struct inotify_event*>(buf + off);
+      off += sizeof(struct inotify_event) + ev->len;
+
+      if (ev->mask & IN_Q_OVERFLOW) {
+        batch.overflow = true;
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(m_);
+      auto w = by_wd_.find(ev->wd);
+      if (w == by_wd_.end()) continue;
+      Dir* dir = w->second;
+      if (ev->mask & IN_IGNORED) {
+        // the directory was deleted or unmounted, its parent's event takes care of the rest
+        dir->wd = -1;
+        by_wd_.erase(w);
+        continue;
+      }
+      if (ev->len == 0) continue;
+      auto [it, inserted] = index.try_emplace(std::make_pair(dir, std::string(ev->name)), batch.changes.size());
+      if (inserted) batch.changes.push_back(Change{dir, it->first.second, false});
+      Change& c = batch.changes[it->second];
+      c.is_dir = c.is_dir || (ev->mask & IN_ISDIR);
+      if (ev->mask & IN_MOVED_FROM) {
+        moved_from[ev->cookie] = it->second;
+      } else if (ev->mask & IN_MOVED_TO) {
+        auto from = moved_from.find(ev->cookie);
+        if (from != moved_from.end()) batch.renames.emplace_back(from->second, it->second);
+      }
+    }
+  }
+}
+
+bool DirWatcher::wait(Batch& batch, int timeout_ms) {
+  removed_.clear();
+  batch.changes.clear();
+  batch.renames.clear();
+  batch.overflow = false;
+
+  pollfd pfd{fd_, POLLIN, 0};
+  if (::poll(&pfd, 1, timeout_ms) <= 0) return false;
+  std::map<std::pair<Dir*, std::string>, size_t> index;
+  std::unordered_map<uint32_t, size_t> moved_from;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kWindowMs);
+  while (true) {
+    read_events(batch, index, moved_from);
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    if (left.count() <= 0) break;
+    pfd.revents = 0;
+    if (::poll(&pfd, 1, static_cast<int>(left.count())) <= 0) break;
+  }
+  return !batch.changes.empty() || batch.overflow;
+}
+
+}
@@ -0,0 +1,91 @@
+#ifndef DIRWATCHER_H_
+#define DIRWATCHER_H_
+// --watch: inotify on every directory a walk went through, and on those created later.
+// The walk registers each directory as it opens it, so nothing that happens during the walk is
+// lost: the events wait in the kernel queue until the initial pass is done and the caller starts
+// calling wait().
+// Events are coalesced. The first one opens a window of kWindowMs, and whatever arrives within it
+// is merged per (directory, name). The caller then looks at the final state of each name once, so
+// a storm of events in one directory costs one check per name, not one per event.
+// When the kernel queue overflows, events were lost anywhere. The batch says so, and the caller
+// rescans the directories whose mtime changed.
+#include <sys/types.h>
+
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "gitignore.h"
+
+namespace gutils {
+
+class DirWatcher {
+public:
+  static constexpr int kWindowMs = 100;
+
+  struct Dir {
+    std::string path;
+    IgnoreStack ignore;  // the rules in effect inside it
+    int depth = 0;
+    int wd = -1;         // -1: not watched, the watch limit was reached
+    dev_t dev = 0;
+    ino_t ino = 0;       // tells a directory from another one moved to its path
+    struct timespec mtime{};
+    bool gone = false;   // removed by remove_tree(), freed at the next wait()
+    std::unordered_set<std::string> matches;  // names of the entries last reported as results
+  };
+
+  // a name in a watched directory that something happened to
+  struct Change {
+    Dir* dir;
+    std::string name;
+    bool is_dir;
+  };
+  struct Batch {
+    std::vector<Change> changes;  // each (dir, name) once, in the order they first came up
+    std::vector<std::pair<size_t, size_t>> renames;  // indexes into changes: old name, new name
+    bool overflow = false;
+  };
+
+  // null when inotify is not available, error says why
+  static std::unique_ptr<DirWatcher> create(std::string& error);
+  ~DirWatcher();
+  DirWatcher(const DirWatcher&) = delete;
+  DirWatcher& operator=(const DirWatcher&) = delete;
+
+  // a directory was entered, fd is open on it. thread safe. the Dir is the caller's to fill in
+  // until the walk is done
+  Dir* add(std::string path, const IgnoreStack& ignore, int depth, int fd);
+  Dir* find(const std::string& path) const;
+  // path and every directory below it are dropped, gone is called for each first (path itself first)
+  void remove_tree(const std::string& path, const std::function<void(Dir&)>& gone);
+  // the directories under watch, and those that are not because of the watch limit
+  std::vector<Dir*> dirs() const;
+  std::vector<Dir*> unwatched() const;
+
+  // wait up to timeout_ms for events, then collect for kWindowMs. false when nothing came.
+  // the Dir pointers in the batch stay valid until the next call
+  bool wait(Batch& batch, int timeout_ms);
+
+private:
+  explicit DirWatcher(int fd) : fd_(fd) {}
+  void read_events(Batch& batch, std::map<std::pair<Dir*, std::string>, size_t>& index,
+                   std::unordered_map<uint32_t, size_t>& moved_from);
+
+  int fd_;
+  mutable std::mutex m_;  // the walk threads in add(), afterwards only the watching thread
+  std::map<std::string, std::unique_ptr<Dir>> by_path_;
+  std::unordered_map<int, Dir*> by_wd_;
+  std::vector<std::unique_ptr<Dir>> removed_;
+  bool warned_ = false;
+};
+
+}
+#endif // DIRWATCHER_H_
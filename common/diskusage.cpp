@@ -0,0 +1,166 @@
+#include "diskusage.h"
+
+#include <algorithm>
+
+namespace gutils {
+
+namespace {
+std::atomic<uint64_t> g_next_du_id{1};
+
+bool larger(const DiskUsage::Entry& a, const DiskUsage::Entry& b) {
+  return a.bytes != b.bytes ? a.bytes > b.bytes : a.name < b.name;
+}
+}
+
+// the slots of one arena, indexed by its ids and allocated in blocks the same way
+struct DiskUsage::Tree {
+  static constexpr int kBlockBits = 14;
+  static constexpr size_t kBlockSlots = size_t(1) << kBlockBits;
+  static constexpr size_t kMaxBlocks = size_t(1) << 16;
+
+  explicit Tree(const PathArena& a) : arena(&a), blocks(new std::atomic<Slot*>[kMaxBlocks]) {
+    for (size_t i = 0; i < kMaxBlocks; ++i) blocks[i].store(nullptr, std::memory_order_relaxed);
+  }
+
+  Slot& slot(PathArena::Id id) {
+    size_t b = id >> kBlockBits;
+    Slot* p = blocks[b].load(std::memory_order_acquire);
+    if (p == nullptr) {
+      std::lock_guard<std::mutex> lock(m);
+      p = blocks[b].load(std::memory_order_relaxed);
+      if (p == nullptr) {
+        owned.push_back(std::make_unique<Slot[]>(kBlockSlots));
+        p = owned.back().get();
+        blocks[b].store(p, std::memory_order_release);
+      }
+    }
+    return p[id & (kBlockSlots - 1)];
+  }
+
+  const PathArena* arena;
+  std::unique_ptr<std::atomic<Slot*>[]> blocks;
+  std::mutex m;  // new blocks only
+  std::vector<std::unique_ptr<Slot[]>> owned;
+};
+
+DiskUsage::DiskUsage() : id_(g_next_du_id.fetch_add(1)) {}
+
+DiskUsage::~DiskUsage() = default;
+
+void DiskUsage::add_root(const PathArena& arena) {
+  trees_.push_back(std::make_unique<Tree>(arena));
+}
+
+DiskUsage::Tree& DiskUsage::tree(const PathArena& arena) const {
+  // a handful of roots at most
+  for (const auto& t : trees_) {
+    if (t->arena == &arena) return *t;
+  }
+  return *trees_.front();
+}
+
+void DiskUsage::finish(const PathArena& arena, PathArena::Id dir, int depth, uint64_t bytes,
+                       uint64_t files, uint32_t children) {
+  Tree& t = tree(arena);
+  Slot& s = t.slot(dir);
+  s.depth = depth;
+  s.bytes.fetch_add(bytes, std::memory_order_relaxed);
+  s.files.fetch_add(files, std::memory_order_relaxed);
+  // the children are queued after this, none of them can have completed yet
+  s.pending.store(children, std::memory_order_release);
+  if (children == 0) complete(t, dir);
+}
+
+void DiskUsage::complete(Tree& t, PathArena::Id id) {
+  while (id != PathArena::kRoot) {
+    Slot& s = t.slot(id);
+    PathArena::Id parent = t.arena->parent(id);
+    Slot& p = t.slot(parent);
+    p.bytes.fetch_add(s.bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    p.files.fetch_add(s.files.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    // acq_rel: whoever takes pending to 0 sees every sibling's additions
+    if (p.pending.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    id = parent;
+  }
+}
+
+void DiskUsage::add_extension(std::string_view name, uint64_t bytes) {
+  // the id, not the address, identifies this DiskUsage, like StatsRegistry::local()
+  thread_local uint64_t cached_id = 0;
+  thread_local ExtMap* cached = nullptr;
+  if (cached_id != id_) {
+    auto map = std::make_unique<ExtMap>();
+    cached = map.get();
+    cached_id = id_;
+    std::lock_guard<std::mutex> lock(m_);
+    ext_maps_.push_back(std::move(map));
+  }
+  // a leading dot is a hidden file, not an extension
+  size_t dot = name.rfind('.');
+  std::string_view ext = dot == std::string_view::npos || dot == 0 ? std::string_view() : name.substr(dot);
+  thread_local std::string key;
+  key.assign(ext);
+  ExtCount& c = (*cached)[key];
+  c.bytes += bytes;
+  ++c.files;
+}
+
+std::vector<DiskUsage::Entry> DiskUsage::top(size_t n, int max_depth) const {
+  std::vector<std::pair<const Tree*, PathArena::Id>> dirs;
+  std::vector<Entry> out;
+  for (const auto& t : trees_) {
+    for (PathArena::Id id = 0; id < t->arena->size(); ++id) {
+      Slot& s = t->slot(id);
+      if (s.depth < 0 || (max_depth != -1 && s.depth > max_depth)) continue;
+      out.push_back(Entry{std::string(), s.bytes.load(std::memory_order_relaxed),
+                          s.files.load(std::memory_order_relaxed)});
+      dirs.emplace_back(t.get(), id);
+    }
+  }
+  // the paths are only built for the ones that make it into the report
+  std::vector<size_t> order(out.size());
+  for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+  auto by_size = [&](size_t a, size_t b) {
+    return out[a].bytes != out[b].bytes ? out[a].bytes > out[b].bytes : a < b;
+  };
+  n = std::min(n, order.size());
+  std::partial_sort(order.begin(), order.begin() + n, order.end(), by_size);
+  std::vector<Entry> result;
+  for (size_t i = 0; i < n; ++i) {
+    Entry e = out[order[i]];
+    e.name = dirs[order[i]].first->arena->path(dirs[order[i]].second);
+    result.push_back(std::move(e));
+  }
+  std::sort(result.begin(), result.end(), larger);
+  return result;
+}
+
+std::vector<DiskUsage::Entry> DiskUsage::roots() const {
+  std::vector<Entry> out;
+  for (const auto& t : trees_) {
+    Slot& s = t->slot(PathArena::kRoot);
+    out.push_back(Entry{t->arena->path(PathArena::kRoot), s.bytes.load(std::memory_order_acquire),
+                        s.files.load(std::memory_order_acquire)});
+  }
+  return out;
+}
+
+std::vector<DiskUsage::Entry> DiskUsage::extensions() const {
+  ExtMap all;
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    for (const auto& map : ext_maps_) {
+      for (const auto& [ext, c] : *map) {
+        ExtCount& a = all[ext];
+        a.bytes += c.bytes;
+        a.files += c.files;
+      }
+    }
+  }
+  std::vector<Entry> out;
+  for (const auto& [ext, c] : all) out.push_back(Entry{ext, c.bytes, c.files});
+  std::sort(out.begin(), out.end(), larger);
+  return out;
+}
+
+}
@@ -0,0 +1,85 @@
+#ifndef DISKUSAGE_H_
+#define DISKUSAGE_H_
+// --du: disk usage per directory, added up by the walk itself.
+// A worker adds up the blocks of a directory's files in plain locals and publishes them once, in
+// finish(). From then on the directory waits for its subdirectories: pending counts the ones that
+// are not complete yet. The last of them adds the subtree totals into the parent and completes the
+// parent in turn, and so on up the PathArena's parent links. All of that is atomics on the
+// directories' own slots, no lock is shared by the workers.
+// Hard links are counted once, like du. The per extension counts are a map per thread, merged
+// once the walk is over.
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "patharena.h"
+#include "visitedset.h"
+
+namespace gutils {
+
+class DiskUsage {
+public:
+  DiskUsage();
+  ~DiskUsage();
+  DiskUsage(const DiskUsage&) = delete;
+  DiskUsage& operator=(const DiskUsage&) = delete;
+
+  // every root's arena, before the walk starts
+  void add_root(const PathArena& arena);
+
+  // the worker is done with dir: bytes and files are its own (the directory's blocks and those
+  // of its files), children the subdirectories it queued. once per directory
+  void finish(const PathArena& arena, PathArena::Id dir, int depth, uint64_t bytes, uint64_t files,
+              uint32_t children);
+
+  // a file with more than one link: true the first time (dev, ino) is seen. thread safe
+  bool first_link(dev_t dev, ino_t ino) { return links_.insert(dev, ino); }
+
+  // --by-ext: a file's blocks under its extension, in this thread's counts
+  void add_extension(std::string_view name, uint64_t bytes);
+
+  struct Entry {
+    std::string name;  // the directory's path, or the extension
+    uint64_t bytes;
+    uint64_t files;
+  };
+  // once the walk is done: the largest directories down to max_depth (-1 for all), at most n
+  std::vector<Entry> top(size_t n, int max_depth) const;
+  // every root's total
+  std::vector<Entry> roots() const;
+  // the extensions, largest first. "" is a name without one
+  std::vector<Entry> extensions() const;
+
+private:
+  struct Slot {
+    std::atomic<uint64_t> bytes{0};     // own, then the subtree once complete
+    std::atomic<uint64_t> files{0};
+    std::atomic<uint32_t> pending{0};   // subdirectories not complete yet
+    int depth = -1;                     // -1: never finished, the walk did not get there
+  };
+  struct Tree;
+  struct ExtCount {
+    uint64_t bytes = 0;
+    uint64_t files = 0;
+  };
+  using ExtMap = std::unordered_map<std::string, ExtCount>;
+
+  Tree& tree(const PathArena& arena) const;
+  void complete(Tree& t, PathArena::Id id);
+
+  uint64_t id_;
+  std::vector<std::unique_ptr<Tree>> trees_;
+  VisitedSet links_;
+  mutable std::mutex m_;  // new ext maps only
+  std::vector<std::unique_ptr<ExtMap>> ext_maps_;
+};
+
+}
+#endif // DISKUSAGE_H_
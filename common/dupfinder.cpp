@@ -0,0 +1,195 @@
+#include "dupfinder.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+namespace gutils {
+
+namespace {
+constexpr size_t kReadSize = 256 * 1024;
+
+// f joins a group. the next stage is due for both members once there are two, for later ones right away
+template <typename T>
+void join(std::vector<T*>& group, T* f, std::vector<T*>& next) {
+  group.push_back(f);
+  if (group.size() == 2) {
+    next = group;
+  } else if (group.size() > 2) {
+    next.push_back(f);
+  }
+}
+
+// n bytes at off, false on an error (errno set) or when the file is shorter now (errno 0)
+bool read_at(int fd, unsigned char* buf, size_t n, off_t off) {
+  while (n > 0) {
+    ssize_t r = ::pread(fd, buf, n, off);
+    if (r < 0 && errno == EINTR) continue;
+    if (r <= 0) {
+      if (r == 0) errno = 0;
+      return false;
+    }
+    buf += r;
+    n -= static_cast<size_t>(r);
+    off += r;
+  }
+  return true;
+}
+}
+
+size_t DuplicateFinder::KeyHash::operator()(const InodeKey& k) const {
+  return std::hash<uint64_t>()(static_cast<uint64_t>(k.ino) * 0x9E3779B97F4A7C15ull ^ k.dev);
+}
+
+size_t DuplicateFinder::KeyHash::operator()(const DigestKey& k) const {
+  // the digest is well mixed already
+  return static_cast<size_t>(k.digest.lo ^ k.size);
+}
+
+DuplicateFinder::DuplicateFinder(Schedule schedule, ErrorLog& errors)
+    : schedule_(std::move(schedule)), error_log_(errors) {}
+
+DuplicateFinder::Shard& DuplicateFinder::shard(uint64_t size) {
+  // sizes cluster on round numbers, spread them before taking the top bits
+  return shards_[(size * 0x9E3779B97F4A7C15ull) >> 58];
+}
+
+void DuplicateFinder::add(std::string_view path, uint64_t size, dev_t dev, ino_t ino) {
+  if (size == 0) return;
+  Shard& s = shard(size);
+  std::vector<File*> next;
+  {
+    std::lock_guard<std::mutex> lock(s.m);
+    auto [it, inserted] = s.inodes.try_emplace(InodeKey{dev, ino}, nullptr);
+    if (!inserted) {
+      // another link to a file seen before: the same contents, but not a duplicate
+      it->second->links.emplace_back(path);
+      links_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    s.files.push_back(File{std::string(path), {}, size, dev, ino, {}, {}});
+    it->second = &s.files.back();
+    join(s.by_size[size], it->second, next);
+  }
+  files_.fetch_add(1, std::memory_order_relaxed);
+  for (File* f : next) schedule_(f->dev, [this, f] { hash_partial(f); });
+}
+
+void DuplicateFinder::failed(const File* f, int err) {
+  errors_.fetch_add(1, std::memory_order_relaxed);
+  if (err != 0) {
+    error_log_.add("Error reading", f->path, err);
+  } else {
+    error_log_.add("Changed during the search, not hashed:", f->path, 0);
+  }
+}
+
+void DuplicateFinder::hash_partial(File* f) {
+  int fd = ::open(f->path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    failed(f, errno);
+    return;
+  }
+  // a small file is read whole, its partial digest is its full one
+  const bool whole = f->size <= 2 * kEdge;
+  unsigned char buf[2 * kEdge];
+  ContentHash h;
+  bool ok;
+  if (whole) {
+    ok = read_at(fd, buf, f->size, 0);
+    if (ok) h.update(buf, f->size);
+  } else {
+    ok = read_at(fd, buf, kEdge, 0) && read_at(fd, buf + kEdge, kEdge, static_cast<off_t>(f->size - kEdge));
+    if (ok) h.update(buf, 2 * kEdge);
+  }
+  int err = errno;
+  ::close(fd);
+  if (!ok) {
+    failed(f, err);
+    return;
+  }
+  f->partial = h.digest();
+  partial_.fetch_add(1, std::memory_order_relaxed);
+
+  Shard& s = shard(f->size);
+  std::vector<File*> next;
+  {
+    std::lock_guard<std::mutex> lock(s.m);
+    if (whole) {
+      f->full = f->partial;
+      s.by_full[DigestKey{f->size, f->full}].push_back(f);
+      return;
+    }
+    join(s.by_partial[DigestKey{f->size, f->partial}], f, next);
+  }
+  for (File* g : next) schedule_(g->dev, [this, g] { hash_full(g); });
+}
+
+void DuplicateFinder::hash_full(File* f) {
+  int fd = ::open(f->path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    failed(f, errno);
+    return;
+  }
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  thread_local std::vector<unsigned char> buf(kReadSize);
+  ContentHash h;
+  uint64_t total = 0;
+  ssize_t r;
+  while ((r = ::read(fd, buf.data(), buf.size())) != 0) {
+    if (r < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    h.update(buf.data(), static_cast<size_t>(r));
+    total += static_cast<uint64_t>(r);
+  }
+  int err = r < 0 ? errno : 0;
+  ::close(fd);
+  if (r < 0 || total != f->size) {
+    failed(f, err);
+    return;
+  }
+  f->full = h.digest();
+  full_.fetch_add(1, std::memory_order_relaxed);
+
+  Shard& s = shard(f->size);
+  std::lock_guard<std::mutex> lock(s.m);
+  s.by_full[DigestKey{f->size, f->full}].push_back(f);
+}
+
+std::vector<DuplicateFinder::Group> DuplicateFinder::groups() const {
+  std::vector<Group> out;
+  for (const Shard& s : shards_) {
+    std::lock_guard<std::mutex> lock(s.m);
+    for (const auto& [key, files] : s.by_full) {
+      if (files.size() < 2) continue;
+      Group g{key.size, {}};
+      for (const File* f : files) {
+        const std::string* first = &f->path;
+        for (const auto& link : f->links) {
+          if (link < *first) first = &link;
+        }
+        g.paths.push_back(*first);
+      }
+      std::sort(g.paths.begin(), g.paths.end());
+      out.push_back(std::move(g));
+    }
+  }
+  std::sort(out.begin(), out.end(), [](const Group& a, const Group& b) { return a.paths[0] < b.paths[0]; });
+  return out;
+}
+
+DuplicateFinder::Counts DuplicateFinder::counts() const {
+  Counts c;
+  c.files = files_.load(std::memory_order_relaxed);
+  c.links = links_.load(std::memory_order_relaxed);
+  c.partial = partial_.load(std::memory_order_relaxed);
+  c.full = full_.load(std::memory_order_relaxed);
+  c.errors = errors_.load(std::memory_order_relaxed);
+  return c;
+}
+
+}
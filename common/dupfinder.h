@@ -0,0 +1,113 @@
+#ifndef DUPFINDER_H_
+#define DUPFINDER_H_
+// --dedupe: files with the same contents, found while the walk is still going.
+// Each file passes through up to three stages, and a stage only sees files that still collide:
+//   size     files of a size nobody else has are never read
+//   partial  the first and last kEdge bytes, which tells most same size files apart
+//   full     the whole file, only for the files whose partial digests are equal too
+// A stage is scheduled for a file as soon as its group gets a second member, so the reads run on
+// the pool alongside the walk instead of after it. Later members go straight to the next stage.
+// A file is identified by device and inode: more hard links to it are one file, never duplicates
+// of each other. The groups live in shards picked by file size, every stage of a file uses the
+// same shard and no lock is global.
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "contenthash.h"
+#include "errorlog.h"
+
+namespace gutils {
+
+class DuplicateFinder {
+public:
+  static constexpr size_t kEdge = 4096;
+
+  // runs a task on a pool thread, dev is the device of the file it reads
+  using Schedule = std::function<void(dev_t dev, std::function<void()> task)>;
+
+  // the files that cannot be read go to errors
+  DuplicateFinder(Schedule schedule, ErrorLog& errors);
+  DuplicateFinder(const DuplicateFinder&) = delete;
+  DuplicateFinder& operator=(const DuplicateFinder&) = delete;
+
+  // a regular file of the walk, from any thread. empty files are left out
+  void add(std::string_view path, uint64_t size, dev_t dev, ino_t ino);
+
+  struct Group {
+    uint64_t size;
+    std::vector<std::string> paths;  // one per inode, the smallest of its links. sorted
+  };
+  // the duplicates, sorted by first path. only once the walk and every scheduled task are done
+  std::vector<Group> groups() const;
+
+  struct Counts {
+    uint64_t files = 0;     // distinct inodes added
+    uint64_t links = 0;     // paths that were another link to one of those
+    uint64_t partial = 0;   // partial hashes done
+    uint64_t full = 0;      // full hashes done
+    uint64_t errors = 0;    // files that could not be read, they are left out
+  };
+  Counts counts() const;
+
+private:
+  struct File {
+    std::string path;                // the first link seen, the hash tasks read this one
+    std::vector<std::string> links;  // the others, under the shard lock
+    uint64_t size;
+    dev_t dev;
+    ino_t ino;
+    Digest128 partial;
+    Digest128 full;
+  };
+
+  struct InodeKey {
+    dev_t dev;
+    ino_t ino;
+    bool operator==(const InodeKey& o) const { return dev == o.dev && ino == o.ino; }
+  };
+  struct DigestKey {
+    uint64_t size;
+    Digest128 digest;
+    bool operator==(const DigestKey& o) const { return size == o.size && digest == o.digest; }
+  };
+  struct KeyHash {
+    size_t operator()(const InodeKey& k) const;
+    size_t operator()(const DigestKey& k) const;
+  };
+
+  struct Shard {
+    mutable std::mutex m;
+    std::deque<File> files;  // stable addresses for the tasks
+    std::unordered_map<InodeKey, File*, KeyHash> inodes;
+    std::unordered_map<uint64_t, std::vector<File*>> by_size;
+    std::unordered_map<DigestKey, std::vector<File*>, KeyHash> by_partial;
+    std::unordered_map<DigestKey, std::vector<File*>, KeyHash> by_full;
+  };
+  static constexpr size_t kShards = 64;
+
+  Shard& shard(uint64_t size);
+  void hash_partial(File* f);
+  void hash_full(File* f);
+  void failed(const File* f, int err);
+
+  Schedule schedule_;
+  ErrorLog& error_log_;
+  Shard shards_[kShards];
+  std::atomic<uint64_t> files_{0};
+  std::atomic<uint64_t> links_{0};
+  std::atomic<uint64_t> partial_{0};
+  std::atomic<uint64_t> full_{0};
+  std::atomic<uint64_t> errors_{0};
+};
+
+}
+#endif // DUPFINDER_H_
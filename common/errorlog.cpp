@@ -0,0 +1,82 @@
+#include "errorlog.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+namespace gutils {
+
+namespace {
+std::atomic<uint64_t> g_next_log_id{1};
+}
+
+ErrorLog::ErrorLog(bool quiet) : id_(g_next_log_id.fetch_add(1)), quiet_(quiet) {}
+
+void ErrorLog::add(const char* what, std::string_view path, int err) {
+  count_.fetch_add(1, std::memory_order_relaxed);
+  // the id, not the address, identifies the log, like StatsRegistry::local()
+  thread_local uint64_t cached_id = 0;
+  thread_local Kinds* cached = nullptr;
+  if (cached_id != id_) {
+    auto kinds = std::make_unique<Kinds>();
+    cached = kinds.get();
+    cached_id = id_;
+    std::lock_guard<std::mutex> lock(m_);
+    threads_.push_back(std::move(kinds));
+  }
+  auto it = std::find_if(cached->begin(), cached->end(),
+                         [&](const Kind& k) { return k.err == err && std::strcmp(k.what, what) == 0; });
+  if (it == cached->end()) {
+    cached->push_back(Kind{what, err, 0, {}});
+    it = cached->end() - 1;
+  }
+  ++it->count;
+  // the smallest paths, which thread saw which path is up to the scheduler
+  auto& ex = it->examples;
+  if (ex.size() < kExamples) {
+    ex.emplace_back(path);
+  } else {
+    auto largest = std::max_element(ex.begin(), ex.end());
+    if (path < *largest) largest->assign(path);
+  }
+}
+
+void ErrorLog::report(std::ostream& out) {
+  Kinds all;
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    for (auto& kinds : threads_) {
+      for (auto& k : *kinds) {
+        auto it = std::find_if(all.begin(), all.end(),
+                               [&](const Kind& a) { return a.err == k.err && std::strcmp(a.what, k.what) == 0; });
+        if (it == all.end()) {
+          all.push_back(Kind{k.what, k.err, 0, {}});
+          it = all.end() - 1;
+        }
+        it->count += k.count;
+        it->examples.insert(it->examples.end(), k.examples.begin(), k.examples.end());
+      }
+      kinds->clear();
+    }
+  }
+  if (quiet_) return;
+  std::sort(all.begin(), all.end(), [](const Kind& a, const Kind& b) { return a.count > b.count; });
+  for (auto& k : all) {
+    std::sort(k.examples.begin(), k.examples.end());
+    k.examples.resize(std::min(k.examples.size(), kExamples));
+    out << k.what;
+    if (k.count == 1) {
+      out << ' ' << std::quoted(k.examples.front());
+      if (k.err != 0) out << ": " << std::strerror(k.err);
+    } else {
+      out << ' ' << k.count << " paths";
+      if (k.err != 0) out << ": " << std::strerror(k.err);
+      out << ", e.g.";
+      for (size_t i = 0; i < k.examples.size(); ++i) out << (i == 0 ? " " : ", ") << std::quoted(k.examples[i]);
+    }
+    out << '\n';
+  }
+  out.flush();
+}
+
+}
@@ -0,0 +1,55 @@
+#ifndef ERRORLOG_H_
+#define ERRORLOG_H_
+// The errors of a walk: directories that cannot be opened or read, files that cannot be stat'ed.
+// On a tree with many permission denied or vanishing directories there are thousands of them, and
+// a locked std::cerr line each costs more than the walk itself. Instead every thread keeps its own
+// list, one entry per kind of error (what failed and the errno) with a count and a few example
+// paths. report() merges the lists and prints one line per kind.
+// count() is a single relaxed atomic, add() takes no lock once the thread has its list.
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gutils {
+
+class ErrorLog {
+public:
+  static constexpr size_t kExamples = 3;  // paths listed per kind, the smallest ones
+
+  // quiet: errors are counted, report() prints nothing
+  explicit ErrorLog(bool quiet = false);
+  ErrorLog(const ErrorLog&) = delete;
+  ErrorLog& operator=(const ErrorLog&) = delete;
+
+  // what is a string literal, "Error accessing". err is the errno, 0 when what says it all
+  void add(const char* what, std::string_view path, int err);
+
+  // errors added so far, report() does not reset it
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+  // the errors added since the last report, most frequent first. only while no thread is adding
+  void report(std::ostream& out);
+
+private:
+  struct Kind {
+    const char* what;
+    int err;
+    uint64_t count;
+    std::vector<std::string> examples;
+  };
+  using Kinds = std::vector<Kind>;  // a handful of kinds at most, searched linearly
+
+  uint64_t id_;
+  bool quiet_;
+  std::atomic<uint64_t> count_{0};
+  std::mutex m_;  // new thread lists only
+  std::vector<std::unique_ptr<Kinds>> threads_;
+};
+
+}
+#endif // ERRORLOG_H_
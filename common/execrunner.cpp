@@ -0,0 +1,269 @@
+#include "execrunner.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace gutils {
+
+namespace {
+// jobs waiting for a free process slot, beyond this the producer blocks
+constexpr size_t kMaxPending = 4096;
+
+bool write_all(int fd, const std::string& data) {
+  size_t off = 0;
+  while (off < data.size()) {
+    ssize_t n = ::write(fd, data.data() + off, data.size() - off);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    off += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+// what one argument costs in the execve argument area
+size_t arg_cost(size_t len) { return len + 1 + sizeof(char*); }
+
+size_t compute_arg_limit(const std::vector<std::string>& cmd) {
+  long max = ::sysconf(_SC_ARG_MAX);
+  size_t limit = max > 0 ? static_cast<size_t>(max) : 128 * 1024;
+  size_t used = 4096;  // headroom for the auxv and alignment
+  for (char** e = environ; *e != nullptr; ++e) used += arg_cost(std::strlen(*e));
+  for (const auto& a : cmd) used += arg_cost(a.size());
+  return limit > used ? limit - used : 0;
+}
+
+void replace_all(std::string& s, std::string_view from, std::string_view to) {
+  for (size_t pos = s.find(from); pos != std::string::npos; pos = s.find(from, pos + to.size())) {
+    s.replace(pos, from.size(), to);
+  }
+}
+}
+
+ExecRunner::ExecRunner(std::vector<std::string> cmd, bool batch, int max_procs)
+    : cmd_(std::move(cmd)), batch_(batch), max_procs_(max_procs > 0 ? max_procs : 1) {
+  arg_limit_ = compute_arg_limit(cmd_);
+  wake_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  thread_ = std::thread(&ExecRunner::run, this);
+}
+
+ExecRunner::~ExecRunner() {
+  finish();
+  if (wake_fd_ >= 0) ::close(wake_fd_);
+}
+
+void ExecRunner::feed(std::string_view chunk) {
+  while (!chunk.empty()) {
+    size_t nl = chunk.find('\n');
+    if (nl == std::string_view::npos) nl = chunk.size();
+    if (nl > 0) add(chunk.substr(0, nl));
+    chunk.remove_prefix(std::min(chunk.size(), nl + 1));
+  }
+}
+
+void ExecRunner::add(std::string_view path) {
+  if (!batch_) {
+    std::vector<std::string> argv;
+    argv.reserve(cmd_.size() + 1);
+    bool placed = false;
+    for (const auto& a : cmd_) {
+      argv.push_back(a);
+      if (a.find("{}") != std::string::npos) {
+        replace_all(argv.back(), "{}", path);
+        placed = true;
+      }
+    }
+    if (!placed) argv.emplace_back(path);
+    submit(std::move(argv));
+    return;
+  }
+
+  size_t cost = arg_cost(path.size());
+  if (!paths_.empty() && paths_bytes_ + cost > arg_limit_) flush_batch();
+  paths_.emplace_back(path);
+  paths_bytes_ += cost;
+}
+
+void ExecRunner::flush_batch() {
+  if (paths_.empty()) return;
+  std::vector<std::string> argv;
+  argv.reserve(cmd_.size() + paths_.size());
+  bool placed = false;
+  for (const auto& a : cmd_) {
+    if (a == "{}") {
+      for (auto& p : paths_) argv.push_back(std::move(p));
+      placed = true;
+    } else {
+      argv.push_back(a);
+    }
+  }
+  if (!placed) {
+    for (auto& p : paths_) argv.push_back(std::move(p));
+  }
+  paths_.clear();
+  paths_bytes_ = 0;
+  submit(std::move(argv));
+}
+
+void ExecRunner::submit(std::vector<std::string> argv) {
+  auto job = std::make_unique<Job>();
+  job->argv = std::move(argv);
+  {
+    std::unique_lock<std::mutex> lock(m_);
+    space_cv_.wait(lock, [this] { return pending_.size() < kMaxPending; });
+    job->seq = next_seq_++;
+    pending_.push_back(std::move(job));
+  }
+  wake();
+}
+
+void ExecRunner::wake() {
+  uint64_t one = 1;
+  ssize_t n = ::write(wake_fd_, &one, sizeof(one));
+  (void)n;  // EAGAIN: the counter is already non zero, run() wakes up anyway
+}
+
+bool ExecRunner::spawn(Job& job) {
+  int out[2], err[2];
+  if (::pipe2(out, O_CLOEXEC) != 0) return false;
+  if (::pipe2(err, O_CLOEXEC) != 0) {
+    ::close(out[0]);
+    ::close(out[1]);
+    return false;
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+  // dup2 clears O_CLOEXEC on the target, everything else of ours stays closed in the child
+  posix_spawn_file_actions_adddup2(&actions, out[1], 1);
+  posix_spawn_file_actions_adddup2(&actions, err[1], 2);
+
+  std::vector<char*> argv;
+  argv.reserve(job.argv.size() + 1);
+  for (auto& a : job.argv) argv.push_back(a.data());
+  argv.push_back(nullptr);
+
+  int rc = ::posix_spawnp(&job.pid, argv[0], &actions, nullptr, argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  ::close(out[1]);
+  ::close(err[1]);
+  if (rc != 0) {
+    ::close(out[0]);
+    ::close(err[0]);
+    job.err = "Error executing " + job.argv[0] + ": " + std::strerror(rc) + "\n";
+    job.pid = -1;
+    return false;
+  }
+  job.out_fd = out[0];
+  job.err_fd = err[0];
+  return true;
+}
+
+void ExecRunner::run() {
+  std::vector<pollfd> fds;
+  char buf[64 * 1024];
+  while (true) {
+    std::vector<std::unique_ptr<Job>> start;
+    {
+      std::lock_guard<std::mutex> lock(m_);
+      while (running_.size() + start.size() < max_procs_ && !pending_.empty()) {
+        start.push_back(std::move(pending_.front()));
+        pending_.pop_front();
+      }
+      if (closing_ && pending_.empty() && running_.empty() && start.empty()) break;
+    }
+    if (!start.empty()) space_cv_.notify_all();
+
+    for (auto& job : start) {
+      if (spawn(*job)) {
+        running_.push_back(std::move(job));
+      } else {
+        if (job->err.empty()) job->err = std::string("Error executing: ") + std::strerror(errno) + "\n";
+        failed_ = true;
+        done_.emplace(job->seq, std::move(job));
+      }
+    }
+
+    fds.clear();
+    fds.push_back(pollfd{wake_fd_, POLLIN, 0});
+    for (auto& job : running_) {
+      if (job->out_fd >= 0) fds.push_back(pollfd{job->out_fd, POLLIN, 0});
+      if (job->err_fd >= 0) fds.push_back(pollfd{job->err_fd, POLLIN, 0});
+    }
+    if (!running_.empty()) {
+      ::poll(fds.data(), fds.size(), -1);
+    } else if (start.empty()) {
+      // nothing to read, only new jobs or finish() can change anything
+      ::poll(fds.data(), 1, -1);
+    }
+    if (fds[0].revents & POLLIN) {
+      uint64_t v;
+      ssize_t n = ::read(wake_fd_, &v, sizeof(v));
+      (void)n;
+    }
+
+    // drain the pipes that are readable. a job is done when both reach EOF
+    for (size_t i = 1; i < fds.size(); ++i) {
+      if (fds[i].revents == 0) continue;
+      for (auto& job : running_) {
+        int* fd = job->out_fd == fds[i].fd ? &job->out_fd : job->err_fd == fds[i].fd ? &job->err_fd : nullptr;
+        if (fd == nullptr) continue;
+        ssize_t n = ::read(*fd, buf, sizeof(buf));
+        if (n > 0) {
+          (fd == &job->out_fd ? job->out : job->err).append(buf, n);
+        } else if (n == 0 || errno != EINTR) {
+          ::close(*fd);
+          *fd = -1;
+        }
+        break;
+      }
+    }
+    for (size_t i = 0; i < running_.size();) {
+      Job& job = *running_[i];
+      if (job.out_fd >= 0 || job.err_fd >= 0) {
+        ++i;
+        continue;
+      }
+      int status = 0;
+      while (::waitpid(job.pid, &status, 0) < 0 && errno == EINTR) {}
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed_ = true;
+      done_.emplace(job.seq, std::move(running_[i]));
+      running_[i] = std::move(running_.back());
+      running_.pop_back();
+    }
+
+    // output in the order the results came in
+    for (auto it = done_.find(next_write_); it != done_.end(); it = done_.find(next_write_)) {
+      write_all(1, it->second->out);
+      write_all(2, it->second->err);
+      done_.erase(it);
+      ++next_write_;
+    }
+  }
+}
+
+int ExecRunner::finish() {
+  if (!thread_.joinable()) return failed_ ? 1 : 0;
+  if (batch_) flush_batch();
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    closing_ = true;
+  }
+  wake();
+  thread_.join();
+  return failed_ ? 1 : 0;
+}
+
+}
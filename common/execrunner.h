@@ -0,0 +1,83 @@
+#ifndef EXECRUNNER_H_
+#define EXECRUNNER_H_
+// -x / -X for the fd tools: run a command on the search results.
+// Results are fed in while the walk is still running. Processes are started with posix_spawn,
+// at most max_procs at a time. Their stdout and stderr are captured and written out in the
+// order the results came in, so the output of two commands never interleaves.
+#include <sys/types.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace gutils {
+
+class ExecRunner {
+public:
+  // cmd is the program and its arguments. -x: every "{}" in an argument is replaced by the path,
+  // -X (batch): a "{}" argument expands to as many paths as fit in ARG_MAX.
+  // without a "{}" the paths are appended
+  ExecRunner(std::vector<std::string> cmd, bool batch, int max_procs);
+  ~ExecRunner();
+  ExecRunner(const ExecRunner&) = delete;
+  ExecRunner& operator=(const ExecRunner&) = delete;
+
+  // newline separated paths, as handed out by OutputSink. feed and add are called from one thread
+  void feed(std::string_view chunk);
+  void add(std::string_view path);
+
+  // start the last batch, wait for every process and write the rest of the output.
+  // 0 when all commands exited with 0, 1 otherwise
+  int finish();
+
+private:
+  struct Job {
+    uint64_t seq = 0;
+    std::vector<std::string> argv;
+    pid_t pid = -1;
+    int out_fd = -1;
+    int err_fd = -1;
+    std::string out;
+    std::string err;
+  };
+
+  void submit(std::vector<std::string> argv);
+  void flush_batch();
+  bool spawn(Job& job);
+  void run();
+  void wake();
+
+  std::vector<std::string> cmd_;
+  bool batch_;
+  size_t max_procs_;
+
+  // -X: the paths of the next invocation and their share of the argument space
+  std::vector<std::string> paths_;
+  size_t paths_bytes_ = 0;
+  size_t arg_limit_ = 0;
+
+  std::mutex m_;
+  std::condition_variable space_cv_;   // submit waits while too many jobs are queued
+  std::deque<std::unique_ptr<Job>> pending_;
+  uint64_t next_seq_ = 0;
+  bool closing_ = false;
+  int wake_fd_ = -1;                   // eventfd, wakes run() out of poll()
+
+  // only touched by run()
+  std::vector<std::unique_ptr<Job>> running_;
+  std::map<uint64_t, std::unique_ptr<Job>> done_;   // finished, waiting for earlier jobs' output
+  uint64_t next_write_ = 0;
+  bool failed_ = false;
+
+  std::thread thread_;
+};
+
+}
+#endif // EXECRUNNER_H_
@@ -0,0 +1,301 @@
+#include "fdindex.h"
+#include "dirreader.h"
+#include "gitignore.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace gutils {
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr char kMagic[8] = {'F', 'D', 'I', 'N', 'D', 'E', 'X', '\0'};
+constexpr uint32_t kVersion = 1;
+
+size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+struct ChildInfo {
+  std::string name;
+  uint8_t type;
+  uint32_t old_dir;  // dir record in the old index, kNoIndex if new or unknown
+};
+
+class IndexBuilder {
+public:
+  explicit IndexBuilder(const FileIndex* old) : old_(old) {}
+
+  void build(const std::string& root) {
+    entries_.push_back(IndexEntry{kNoIndex, 0, 0, DT_DIR, 0, 0});
+    dirs_.push_back(IndexDir{0, 0, 0, 0, 0, 0});
+    std::string path = root;
+    visit(0, path, old_ ? old_->entry(0).dir : kNoIndex, nullptr);
+  }
+
+  bool write(const std::string& file, const std::string& root) const;
+
+private:
+  // fill in the children of dir record d, found at path. old_dir is the same directory in old_,
+  // parent_ignore the .gitignore rules in effect for its parent
+  void visit(uint32_t d, std::string& path, uint32_t old_dir, const IgnoreStack& parent_ignore) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+      std::cerr << "Error accessing " << path << ": " << std::strerror(errno) << std::endl;
+      return;
+    }
+    dirs_[d].mtime_sec = st.st_mtim.tv_sec;
+    dirs_[d].mtime_nsec = st.st_mtim.tv_nsec;
+
+    std::vector<ChildInfo> children;
+    IgnoreStack ignore = parent_ignore;
+    if (old_dir != kNoIndex && same_mtime(old_->dir(old_dir), st)) {
+      // unchanged since the old index was built, its entry list is still valid (and already filtered).
+      // the .gitignore is still needed for subdirectories that changed
+      const IndexDir& od = old_->dir(old_dir);
+      children.reserve(od.child_count);
+      for (uint32_t i = od.first_child; i < od.first_child + od.child_count; ++i) {
+        const IndexEntry& e = old_->entry(i);
+        children.push_back(ChildInfo{std::string(old_->name(i)), e.type, e.dir});
+        if (old_->name(i) == ".gitignore") ignore = IgnoreNode::enter(path, parent_ignore);
+      }
+    } else {
+      read_children(path, old_dir, parent_ignore, ignore, children);
+    }
+
+    uint32_t first = static_cast<uint32_t>(entries_.size());
+    dirs_[d].first_child = first;
+    dirs_[d].child_count = static_cast<uint32_t>(children.size());
+    for (const auto& c : children) {
+      IndexEntry e{dirs_[d].entry, static_cast<uint32_t>(names_.size()),
+                   static_cast<uint16_t>(c.name.size()), c.type, 0, kNoIndex};
+      names_ += c.name;
+      if (c.type == DT_DIR) {
+        e.dir = static_cast<uint32_t>(dirs_.size());
+        dirs_.push_back(IndexDir{static_cast<uint32_t>(entries_.size()), 0, 0, 0, 0, 0});
+      }
+      entries_.push_back(e);
+    }
+
+    for (size_t i = 0; i < children.size(); ++i) {
+      if (children[i].type != DT_DIR) continue;
+      size_t old_size = path.size();
+      if (path.back() != '/') path += '/';
+      path += children[i].name;
+      visit(entries_[first + i].dir, path, children[i].old_dir, ignore);
+      path.resize(old_size);
+    }
+  }
+
+  // read path from disk. ignore is set to the rules in effect inside path, the .gitignore is only
+  // opened when the listing contains one
+  void read_children(const std::string& path, uint32_t old_dir, const IgnoreStack& parent_ignore,
+                     IgnoreStack& ignore, std::vector<ChildInfo>& children) {
+    if (!reader_.open(path.c_str())) {
+      std::cerr << "Error accessing " << path << ": " << std::strerror(reader_.error()) << std::endl;
+      return;
+    }
+    // subdirectories that were already in the old index keep their old record,
+    // so their own subtrees can be reused if they did not change
+    std::unordered_map<std::string_view, uint32_t> old_subdirs;
+    if (old_dir != kNoIndex) {
+      const IndexDir& od = old_->dir(old_dir);
+      for (uint32_t i = od.first_child; i < od.first_child + od.child_count; ++i) {
+        if (old_->entry(i).dir != kNoIndex) old_subdirs.emplace(old_->name(i), old_->entry(i).dir);
+      }
+    }
+
+    std::vector<ChildInfo> all;
+    bool has_gitignore = false;
+    DirEntry entry;
+    while (reader_.next(entry)) {
+      if (entry.name.size() > 0xffff) continue;
+      uint8_t type = reader_.resolve_type(entry);
+      uint32_t od = kNoIndex;
+      if (type == DT_DIR) {
+        auto it = old_subdirs.find(entry.name);
+        if (it != old_subdirs.end()) od = it->second;
+      }
+      if (entry.name == ".gitignore") has_gitignore = true;
+      all.push_back(ChildInfo{std::string(entry.name), type, od});
+    }
+    if (reader_.error() != 0) {
+      std::cerr << "Error reading " << path << ": " << std::strerror(reader_.error()) << std::endl;
+    }
+    ignore = has_gitignore ? IgnoreNode::enter(reader_.fd(), path, parent_ignore) : parent_ignore;
+    reader_.close();
+
+    children.reserve(all.size());
+    for (auto& c : all) {
+      if (ignore && ignore->is_ignored(path + '/' + c.name, c.type == DT_DIR)) continue;
+      children.push_back(std::move(c));
+    }
+  }
+
+  static bool same_mtime(const IndexDir& d, const struct stat& st) {
+    return d.mtime_sec == st.st_mtim.tv_sec && d.mtime_nsec == st.st_mtim.tv_nsec;
+  }
+
+  const FileIndex* old_;
+  DirReader reader_;
+  std::vector<IndexEntry> entries_;
+  std::vector<IndexDir> dirs_;
+  std::string names_;
+};
+
+bool write_all(int fd, const void* data, size_t len) {
+  const char* p = static_cast<const char*>(data);
+  while (len > 0) {
+    ssize_t n = ::write(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    p += n;
+    len -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool write_padding(int fd, size_t len) {
+  static const char zeros[8] = {};
+  return write_all(fd, zeros, align8(len) - len);
+}
+
+bool IndexBuilder::write(const std::string& file, const std::string& root) const {
+  IndexHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.entry_count = static_cast<uint32_t>(entries_.size());
+  header.dir_count = static_cast<uint32_t>(dirs_.size());
+  header.names_size = names_.size();
+  header.root_size = root.size();
+  header.built_at = static_cast<int64_t>(std::time(nullptr));
+
+  std::string tmp = file + ".tmp";
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::cerr << "Error: Failed to open index '" << tmp << "': " << std::strerror(errno) << '\n';
+    return false;
+  }
+  bool ok = write_all(fd, &header, sizeof(header)) &&
+            write_all(fd, entries_.data(), entries_.size() * sizeof(IndexEntry)) &&
+            write_padding(fd, entries_.size() * sizeof(IndexEntry)) &&
+            write_all(fd, dirs_.data(), dirs_.size() * sizeof(IndexDir)) &&
+            write_all(fd, names_.data(), names_.size()) &&
+            write_padding(fd, names_.size()) &&
+            write_all(fd, root.data(), root.size());
+  ok = (::close(fd) == 0) && ok;
+  if (!ok || std::rename(tmp.c_str(), file.c_str()) != 0) {
+    std::cerr << "Error: Failed to write index '" << file << "': " << std::strerror(errno) << '\n';
+    ::unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+}
+
+std::unique_ptr<FileIndex> FileIndex::open(const std::string& file) {
+  int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    std::cerr << "Error: Failed to open index '" << file << "': " << std::strerror(errno) << '\n';
+    return nullptr;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(IndexHeader)) {
+    ::close(fd);
+    std::cerr << "Error: '" << file << "' is not an index\n";
+    return nullptr;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    std::cerr << "Error: Failed to mmap index '" << file << "': " << std::strerror(errno) << '\n';
+    return nullptr;
+  }
+
+  std::unique_ptr<FileIndex> index(new FileIndex());
+  index->map_ = map;
+  index->map_size_ = size;
+  const char* base = static_cast<const char*>(map);
+  const auto* header = reinterpret_cast<const IndexHeader*>(base);
+
+  size_t entries_off = sizeof(IndexHeader);
+  size_t dirs_off = entries_off + align8(header->entry_count * sizeof(IndexEntry));
+  size_t names_off = dirs_off + header->dir_count * sizeof(IndexDir);
+  size_t root_off = names_off + align8(header->names_size);
+  if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion ||
+      header->entry_count == 0 || root_off + header->root_size != size) {
+    std::cerr << "Error: '" << file << "' is not an index or has an unsupported version\n";
+    return nullptr;
+  }
+  index->header_ = header;
+  index->entries_ = reinterpret_cast<const IndexEntry*>(base + entries_off);
+  index->dirs_ = reinterpret_cast<const IndexDir*>(base + dirs_off);
+  index->names_ = base + names_off;
+  index->root_ = std::string_view(base + root_off, header->root_size);
+  // sequential scans over the whole table are the common case
+  ::madvise(map, size, MADV_WILLNEED);
+  return index;
+}
+
+FileIndex::~FileIndex() {
+  if (map_) ::munmap(map_, map_size_);
+}
+
+int FileIndex::depth(uint32_t i) const {
+  int d = 0;
+  for (uint32_t p = entries_[i].parent; p != kNoIndex; p = entries_[p].parent) ++d;
+  return d;
+}
+
+std::string FileIndex::path(uint32_t i) const {
+  // collect the chain bottom up, then append top down
+  uint32_t chain[256];
+  std::vector<uint32_t> deep;
+  size_t n = 0;
+  for (uint32_t p = i; p != 0 && p != kNoIndex; p = entries_[p].parent) {
+    if (n < 256) chain[n++] = p;
+    else deep.push_back(p);
+  }
+  std::string result(root_);
+  for (auto it = deep.rbegin(); it != deep.rend(); ++it) {
+    if (result.empty() || result.back() != '/') result += '/';
+    result += name(*it);
+  }
+  while (n > 0) {
+    if (result.empty() || result.back() != '/') result += '/';
+    result += name(chain[--n]);
+  }
+  return result;
+}
+
+bool FileIndex::built_for(const fs::path& dir) const {
+  std::error_code ec1, ec2;
+  fs::path a = fs::weakly_canonical(fs::path(std::string(root_)), ec1);
+  fs::path b = fs::weakly_canonical(dir, ec2);
+  if (ec1 || ec2) return fs::path(std::string(root_)) == dir;
+  return a == b;
+}
+
+bool build_file_index(const fs::path& root, const std::string& file, const FileIndex* old) {
+  std::string root_str = root.string();
+  if (old && !old->built_for(root)) {
+    std::cerr << "Index root " << old->root() << " differs from " << root_str << ", rebuilding\n";
+    old = nullptr;
+  }
+  IndexBuilder builder(old);
+  builder.build(root_str);
+  return builder.write(file, root_str);
+}
+
+}
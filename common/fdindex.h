@@ -0,0 +1,98 @@
+#ifndef FDINDEX_H_
+#define FDINDEX_H_
+// Persistent filename index for the fd tools.
+// Layout of the file, everything native endian and 8 byte aligned:
+//   IndexHeader
+//   IndexEntry[entry_count]  path table; parent makes it a tree, entry 0 is the root directory
+//   IndexDir[dir_count]      one record per directory: its children and its mtime when it was read
+//   names blob               all file names back to back, not NUL terminated
+//   root path
+// The children of a directory are contiguous in the entry table, so a directory can be copied
+// from an old index without reading it again when its mtime did not change.
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace gutils {
+
+struct IndexHeader {
+  char magic[8];            // "FDINDEX\0"
+  uint32_t version;
+  uint32_t entry_count;
+  uint32_t dir_count;
+  uint32_t reserved;
+  uint64_t names_size;
+  uint64_t root_size;
+  int64_t built_at;         // unix seconds
+};
+
+struct IndexEntry {
+  uint32_t parent;          // entry index of the parent directory, kNoIndex for the root
+  uint32_t name_off;        // into the names blob
+  uint16_t name_len;
+  uint8_t type;             // DT_DIR, DT_REG, ...
+  uint8_t reserved;
+  uint32_t dir;             // index into the dir table for directories, kNoIndex otherwise
+};
+
+struct IndexDir {
+  uint32_t entry;
+  uint32_t first_child;     // entry index of the first child
+  uint32_t child_count;
+  uint32_t reserved;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+};
+
+constexpr uint32_t kNoIndex = 0xffffffffu;
+
+// Read only view of an index file, the file is mmapped and never copied.
+class FileIndex {
+public:
+  // nullptr if the file is missing or not a valid index, the reason goes to std::cerr
+  static std::unique_ptr<FileIndex> open(const std::string& file);
+  ~FileIndex();
+  FileIndex(const FileIndex&) = delete;
+  FileIndex& operator=(const FileIndex&) = delete;
+
+  uint32_t size() const { return header_->entry_count; }
+  const IndexEntry& entry(uint32_t i) const { return entries_[i]; }
+  const IndexDir& dir(uint32_t i) const { return dirs_[i]; }
+  std::string_view name(uint32_t i) const {
+    return std::string_view(names_ + entries_[i].name_off, entries_[i].name_len);
+  }
+  std::string_view root() const { return root_; }
+  // the index was built for dir: the same directory once both are made absolute and canonical,
+  // "." and its full path are the same root
+  bool built_for(const std::filesystem::path& dir) const;
+  int64_t built_at() const { return header_->built_at; }
+
+  // number of parents between the entry and the root, children of the root are depth 1
+  int depth(uint32_t i) const;
+  // full path, only built when somebody wants to print it
+  std::string path(uint32_t i) const;
+
+private:
+  FileIndex() = default;
+
+  void* map_ = nullptr;
+  size_t map_size_ = 0;
+  const IndexHeader* header_ = nullptr;
+  const IndexEntry* entries_ = nullptr;
+  const IndexDir* dirs_ = nullptr;
+  const char* names_ = nullptr;
+  std::string_view root_;
+};
+
+// Walk root and write the index to file (through file.tmp + rename, so a running query keeps its
+// mapping). Entries ignored by the .gitignore files met on the way are left out.
+// With old, a directory whose mtime is unchanged since old was built is copied from old instead of
+// being read again; its subdirectories are still checked one by one. Editing a .gitignore does not
+// change its directory's mtime, rebuild without old after that.
+bool build_file_index(const std::filesystem::path& root, const std::string& file,
+                      const FileIndex* old = nullptr);
+
+}
+#endif // FDINDEX_H_
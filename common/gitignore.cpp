@@ -0,0 +1,137 @@
+#include "gitignore.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+
+#include "glob.h"
+
+namespace gutils {
+
+namespace {
+std::string read_all(int fd) {
+  std::string text;
+  char buf[16 * 1024];
+  ssize_t n;
+  while ((n = ::read(fd, buf, sizeof(buf))) != 0) {
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    text.append(buf, static_cast<size_t>(n));
+  }
+  return text;
+}
+}
+
+IgnoreStack IgnoreNode::from_text(std::string_view text, std::string_view base, const IgnoreStack& parent) {
+  auto node = std::shared_ptr<IgnoreNode>(new IgnoreNode());
+  // git matches bytes case sensitively and has no braces
+  GlobOptions options;
+  options.path = true;
+  options.braces = false;
+  std::vector<std::string_view> patterns;
+
+  while (!text.empty()) {
+    size_t nl = text.find('\n');
+    std::string_view line = text.substr(0, nl);
+    text = nl == std::string_view::npos ? std::string_view() : text.substr(nl + 1);
+
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    // trailing spaces are ignored unless escaped
+    while (!line.empty() && line.back() == ' ' && !(line.size() > 1 && line[line.size() - 2] == '\\')) {
+      line.remove_suffix(1);
+    }
+    if (line.empty() || line[0] == '#') continue;
+
+    bool negate = false;
+    bool dir_only = false;
+    if (line[0] == '!') {
+      negate = true;
+      line.remove_prefix(1);
+    }
+    if (!line.empty() && line.back() == '/') {
+      dir_only = true;
+      line.remove_suffix(1);
+    }
+    if (line.empty()) continue;
+
+    // a '/' anywhere but at the end anchors the pattern to the .gitignore directory.
+    // without one the pattern matches at any depth, and as its stars cannot cross a '/'
+    // only the last component can match it
+    bool anchored = line.find('/') != std::string_view::npos;
+    if (line[0] == '/') line.remove_prefix(1);
+
+    node->rules_.push_back(Rule{negate, dir_only, !anchored});
+    patterns.push_back(line);
+  }
+
+  if (node->rules_.empty()) return parent;
+  RE2::Options re2_options;
+  // thousands of patterns in one automaton need more than the 8 MiB default
+  re2_options.set_max_mem(64 << 20);
+  node->set_ = std::make_unique<RE2::Set>(re2_options, RE2::UNANCHORED);
+  for (size_t i = 0; i < patterns.size(); ++i) {
+    // the Glob parser's translation, a rule without '/' matches after any '/'
+    std::string regex = (node->rules_[i].basename ? "(?:^|/)" : "^") + glob_to_re2(patterns[i], options) + "$";
+    std::string error;
+    if (node->set_->Add(regex, &error) < 0) {
+      // never expected, the translation escapes everything. the index has to stay in step with rules_
+      std::cerr << "Invalid .gitignore pattern '" << patterns[i] << "' in " << base << ": " << error << std::endl;
+      node->set_->Add("[^\\x{0}-\\x{10ffff}]", nullptr);
+    }
+  }
+  if (!node->set_->Compile()) {
+    std::cerr << "Failed to compile .gitignore rules in " << base << std::endl;
+    return parent;
+  }
+  node->parent_ = parent;
+  node->base_len_ = base.size();
+  return node;
+}
+
+IgnoreStack IgnoreNode::enter(int dir_fd, std::string_view dir_path, const IgnoreStack& parent) {
+  int fd = ::openat(dir_fd, ".gitignore", O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return parent;
+  std::string text = read_all(fd);
+  ::close(fd);
+  return from_text(text, dir_path, parent);
+}
+
+IgnoreStack IgnoreNode::enter(std::string_view dir_path, const IgnoreStack& parent) {
+  int dir_fd = ::open(std::string(dir_path).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir_fd < 0) return parent;
+  IgnoreStack node = enter(dir_fd, dir_path, parent);
+  ::close(dir_fd);
+  return node;
+}
+
+int IgnoreNode::match(std::string_view path, bool is_dir) const {
+  std::string_view rel = path.substr(std::min(base_len_, path.size()));
+  while (!rel.empty() && rel[0] == '/') rel.remove_prefix(1);
+  if (rel.empty()) return -1;
+
+  thread_local std::vector<int> hits;
+  hits.clear();
+  if (!set_->Match(rel, &hits)) return -1;
+  // the last matching rule wins
+  int best = -1;
+  for (int idx : hits) {
+    if (rules_[idx].dir_only && !is_dir) continue;
+    if (idx > best) best = idx;
+  }
+  if (best < 0) return -1;
+  return rules_[best].negate ? 0 : 1;
+}
+
+bool IgnoreNode::is_ignored(std::string_view path, bool is_dir) const {
+  for (const IgnoreNode* n = this; n; n = n->parent_.get()) {
+    int r = n->match(path, is_dir);
+    if (r >= 0) return r == 1;
+  }
+  return false;
+}
+
+}
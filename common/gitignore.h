@@ -0,0 +1,62 @@
+#ifndef GITIGNORE_H_
+#define GITIGNORE_H_
+// Hierarchical .gitignore matching.
+// The walk calls IgnoreNode::enter for every directory it opens. A directory with a .gitignore gets
+// a node holding all of its rules compiled; its children point to it through a shared_ptr, so
+// parent rules are shared by reference, never copied or recompiled.
+// The rules are translated by the Glob parser (glob_to_re2) and go into a single RE2::Set, one
+// automaton for all of them whatever their number, and the highest matching index wins. Even at
+// 20 rules that beats trying a Glob program per rule from the last one back.
+// A directory without .gitignore simply passes its parent's node down.
+//
+// Matching is gitignore style: a pattern without '/' matches the name at any depth below its
+// .gitignore, a pattern with '/' is anchored to that directory, a trailing '/' only matches
+// directories, '!' re-includes, and the last matching rule wins with deeper files taking precedence.
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <re2/set.h>
+
+namespace gutils {
+
+class IgnoreNode;
+using IgnoreStack = std::shared_ptr<const IgnoreNode>;
+
+class IgnoreNode {
+public:
+  // dir_fd is the open directory at dir_path, .gitignore is opened relative to it.
+  // Returns parent when there is no .gitignore or it has no valid rule.
+  static IgnoreStack enter(int dir_fd, std::string_view dir_path, const IgnoreStack& parent);
+  // same, but dir_path is opened by name
+  static IgnoreStack enter(std::string_view dir_path, const IgnoreStack& parent);
+
+  // rules parsed from text, base is the directory the rules are relative to
+  static IgnoreStack from_text(std::string_view text, std::string_view base, const IgnoreStack& parent);
+
+  // path is the full path of an entry somewhere below base
+  bool is_ignored(std::string_view path, bool is_dir) const;
+
+private:
+  struct Rule {
+    bool negate;
+    bool dir_only;
+    bool basename;  // no '/' in the pattern: matched against the last component only
+  };
+
+  // -1: no rule of this node matches, otherwise 0 (included again) or 1 (ignored)
+  int match(std::string_view path, bool is_dir) const;
+
+  IgnoreStack parent_;
+  size_t base_len_ = 0;
+  std::vector<Rule> rules_;
+  std::unique_ptr<RE2::Set> set_;  // rule i is regex i
+};
+
+inline bool is_ignored(const IgnoreStack& ignore, std::string_view path, bool is_dir) {
+  return ignore && ignore->is_ignored(path, is_dir);
+}
+
+}
+#endif // GITIGNORE_H_
@@ -0,0 +1,666 @@
+#include "glob.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+namespace gutils {
+
+namespace {
+// bytes that are not valid UTF-8 decode to this plus the byte, in the pattern and in the name
+// alike, so they still match themselves
+constexpr char32_t kRawByte = 0x110000;
+
+char32_t next_char(std::string_view s, size_t& pos) {
+  unsigned char b = static_cast<unsigned char>(s[pos]);
+  if (b < 0x80) {
+    ++pos;
+    return b;
+  }
+  size_t len = b >= 0xF0 ? 4 : b >= 0xE0 ? 3 : b >= 0xC0 ? 2 : 0;
+  if (len == 0 || b > 0xF4 || pos + len > s.size()) {
+    ++pos;
+    return kRawByte + b;
+  }
+  char32_t c = b & (0x7F >> len);
+  for (size_t k = 1; k < len; ++k) {
+    unsigned char cont = static_cast<unsigned char>(s[pos + k]);
+    if ((cont & 0xC0) != 0x80) {
+      ++pos;
+      return kRawByte + b;
+    }
+    c = (c << 6) | (cont & 0x3F);
+  }
+  pos += len;
+  return c;
+}
+
+void append_utf8(std::string& out, char32_t c) {
+  if (c >= kRawByte) {
+    out += static_cast<char>(c - kRawByte);
+  } else if (c < 0x80) {
+    out += static_cast<char>(c);
+  } else if (c < 0x800) {
+    out += static_cast<char>(0xC0 | (c >> 6));
+    out += static_cast<char>(0x80 | (c & 0x3F));
+  } else if (c < 0x10000) {
+    out += static_cast<char>(0xE0 | (c >> 12));
+    out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (c & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (c >> 18));
+    out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (c & 0x3F));
+  }
+}
+
+inline char32_t fold(char32_t c) { return c - 'A' < 26 ? c + 32 : c; }
+
+// branch free ASCII lower case, keeps the loops below vectorizable
+inline unsigned char fold_byte(unsigned char c) {
+  return static_cast<unsigned char>(c + (static_cast<unsigned char>(c - 'A') < 26) * 32);
+}
+
+// no early exit on purpose: names are short and a straight OR-reduction is what the
+// compiler turns into SIMD compares
+bool equal_fold(const char* a, const char* lower, size_t n) {
+  unsigned char diff = 0;
+  for (size_t i = 0; i < n; ++i) {
+    diff |= fold_byte(static_cast<unsigned char>(a[i])) ^ static_cast<unsigned char>(lower[i]);
+  }
+  return diff == 0;
+}
+
+bool find_fold(std::string_view hay, std::string_view lower) {
+  const unsigned char first = static_cast<unsigned char>(lower[0]);
+  const size_t last = hay.size() - lower.size();
+  for (size_t i = 0; i <= last; ++i) {
+    if (fold_byte(static_cast<unsigned char>(hay[i])) == first &&
+        equal_fold(hay.data() + i + 1, lower.data() + 1, lower.size() - 1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// a parsed pattern, compiled to the program or printed as a regex
+struct Node;
+using Seq = std::vector<Node>;
+
+struct Node {
+  enum Kind {
+    kChar,     // c
+    kAny,      // ?
+    kClass,    // [...], cls indexes the class list
+    kStar,     // *
+    kAnyPath,  // trailing "/**": everything, '/' included
+    kDirs,     // "**/": zero or more directories
+    kAlt,      // {a,b}
+  } kind;
+  char32_t c = 0;
+  size_t cls = 0;
+  std::vector<Seq> alts = {};
+};
+
+struct ParsedClass {
+  bool negate = false;
+  std::vector<std::pair<char32_t, char32_t>> ranges;  // as written, before folding
+};
+
+class Parser {
+public:
+  Parser(std::string_view pattern, const GlobOptions& options) : options_(options) {
+    for (size_t pos = 0; pos < pattern.size();) p_.push_back(next_char(pattern, pos));
+  }
+
+  Seq parse() {
+    size_t i = 0;
+    return seq(i, false);
+  }
+
+  std::vector<ParsedClass> classes;
+
+private:
+  // until the end, or ',' and '}' inside braces
+  Seq seq(size_t& i, bool in_brace) {
+    Seq out;
+    while (i < p_.size()) {
+      char32_t c = p_[i];
+      if (in_brace && (c == ',' || c == '}')) break;
+      if (c == '\\') {
+        // a trailing backslash is itself
+        out.push_back(literal(i + 1 < p_.size() ? p_[i + 1] : c));
+        i += i + 1 < p_.size() ? 2 : 1;
+      } else if (c == '*') {
+        star(i, out);
+      } else if (c == '?') {
+        out.push_back(Node{Node::kAny});
+        ++i;
+      } else if (c == '[' && klass(i, out)) {
+      } else if (c == '{' && options_.braces && brace(i, out)) {
+      } else {
+        out.push_back(literal(c));
+        ++i;
+      }
+    }
+    return out;
+  }
+
+  Node literal(char32_t c) {
+    Node n{Node::kChar};
+    n.c = c;
+    return n;
+  }
+
+  void star(size_t& i, Seq& out) {
+    // the gitignore forms, only with path semantics and only at the start of a component
+    if (options_.path && i + 1 < p_.size() && p_[i + 1] == '*' && (i == 0 || p_[i - 1] == '/')) {
+      if (i + 2 < p_.size() && p_[i + 2] == '/') {
+        out.push_back(Node{Node::kDirs});
+        i += 3;
+        return;
+      }
+      if (i + 2 == p_.size()) {
+        out.push_back(Node{Node::kAnyPath});
+        i += 2;
+        return;
+      }
+    }
+    // any other run of stars is one star
+    while (i < p_.size() && p_[i] == '*') ++i;
+    out.push_back(Node{Node::kStar});
+  }
+
+  // [...] at p_[i]. false when unterminated, the '[' is then a literal
+  bool klass(size_t& i, Seq& out) {
+    size_t j = i + 1;
+    ParsedClass cls;
+    if (j < p_.size() && (p_[j] == '!' || p_[j] == '^')) {
+      cls.negate = true;
+      ++j;
+    }
+    bool first = true;
+    while (j < p_.size() && (first || p_[j] != ']')) {
+      first = false;
+      if (p_[j] == '[' && j + 1 < p_.size() && p_[j + 1] == ':' && posix(j, cls)) continue;
+      char32_t lo = p_[j];
+      if (lo == '\\' && j + 1 < p_.size()) lo = p_[++j];
+      ++j;
+      char32_t hi = lo;
+      // a '-' right before the ']' is a member
+      if (j + 1 < p_.size() && p_[j] == '-' && p_[j + 1] != ']') {
+        hi = p_[j + 1];
+        j += 2;
+        if (hi == '\\' && j < p_.size()) hi = p_[j++];
+      }
+      if (lo <= hi) cls.ranges.emplace_back(lo, hi);
+    }
+    if (j >= p_.size()) return false;
+    Node n{Node::kClass};
+    n.cls = classes.size();
+    classes.push_back(std::move(cls));
+    out.push_back(std::move(n));
+    i = j + 1;
+    return true;
+  }
+
+  // [:name:] at p_[j] inside a class
+  bool posix(size_t& j, ParsedClass& cls) {
+    static const struct {
+      const char* name;
+      std::vector<std::pair<char32_t, char32_t>> ranges;
+    } kClasses[] = {
+      {"alpha", {{'a', 'z'}, {'A', 'Z'}}},
+      {"digit", {{'0', '9'}}},
+      {"alnum", {{'a', 'z'}, {'A', 'Z'}, {'0', '9'}}},
+      {"upper", {{'A', 'Z'}}},
+      {"lower", {{'a', 'z'}}},
+      {"space", {{' ', ' '}, {'\t', '\r'}}},
+      {"xdigit", {{'0', '9'}, {'a', 'f'}, {'A', 'F'}}},
+      {"punct", {{'!', '/'}, {':', '@'}, {'[', '`'}, {'{', '~'}}},
+    };
+    size_t end = j + 2;
+    std::string name;
+    while (end < p_.size() && p_[end] != ':' && p_[end] < 0x80) name += static_cast<char>(p_[end++]);
+    if (end + 1 >= p_.size() || p_[end] != ':' || p_[end + 1] != ']') return false;
+    for (auto& k : kClasses) {
+      if (name == k.name) {
+        cls.ranges.insert(cls.ranges.end(), k.ranges.begin(), k.ranges.end());
+        j = end + 2;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // {a,b} at p_[i]. false without a matching '}' or a ',', the '{' is then a literal
+  bool brace(size_t& i, Seq& out) {
+    int depth = 0;
+    bool comma = false;
+    size_t j = i;
+    for (; j < p_.size(); ++j) {
+      if (p_[j] == '\\') {
+        ++j;
+      } else if (p_[j] == '{') {
+        ++depth;
+      } else if (p_[j] == '}') {
+        if (--depth == 0) break;
+      } else if (p_[j] == ',' && depth == 1) {
+        comma = true;
+      }
+    }
+    if (j >= p_.size() || !comma) return false;
+
+    Node n{Node::kAlt};
+    size_t k = i + 1;
+    while (true) {
+      n.alts.push_back(seq(k, true));
+      // the scan above does not know about classes, "{[,]}" can end up here without a '}'
+      if (k >= p_.size() || p_[k] == '}') break;
+      ++k;  // ','
+    }
+    out.push_back(std::move(n));
+    i = k + 1;
+    return true;
+  }
+
+  GlobOptions options_;
+  std::vector<char32_t> p_;
+};
+}
+
+class GlobCompiler {
+public:
+  explicit GlobCompiler(Glob& g) : g_(g) {}
+
+  void emit(const Seq& seq) {
+    for (const Node& n : seq) {
+      switch (n.kind) {
+      case Node::kChar:
+        push(Glob::kChar, g_.options_.case_sensitive ? n.c : fold(n.c));
+        break;
+      case Node::kAny:
+        push(Glob::kAny, 0);
+        break;
+      case Node::kClass:
+        push(Glob::kClass, static_cast<uint32_t>(n.cls));
+        break;
+      case Node::kStar:
+        push(Glob::kLoop, 0);
+        break;
+      case Node::kAnyPath:
+        push(Glob::kLoopAll, 0);
+        break;
+      case Node::kDirs: {
+        // (.*/)?
+        size_t split = push(Glob::kSplit, 0);
+        push(Glob::kLoopAll, 0);
+        push(Glob::kChar, '/');
+        g_.prog_[split].arg = here();
+        break;
+      }
+      case Node::kAlt: {
+        std::vector<size_t> jumps;
+        for (size_t a = 0; a < n.alts.size(); ++a) {
+          bool last = a + 1 == n.alts.size();
+          size_t split = last ? 0 : push(Glob::kSplit, 0);
+          emit(n.alts[a]);
+          if (!last) {
+            jumps.push_back(push(Glob::kJump, 0));
+            g_.prog_[split].arg = here();
+          }
+        }
+        for (size_t j : jumps) g_.prog_[j].arg = here();
+        break;
+      }
+      }
+    }
+  }
+
+  void add_classes(const std::vector<ParsedClass>& parsed) {
+    for (const ParsedClass& pc : parsed) {
+      Glob::CharClass cls;
+      cls.negate = pc.negate;
+      for (auto [lo, hi] : pc.ranges) {
+        for (char32_t c = lo; c <= hi && c < 0x80; ++c) {
+          set_ascii(cls, c);
+          // both cases in the class, the name is folded to lower case before it is looked up
+          if (!g_.options_.case_sensitive) set_ascii(cls, fold(c));
+        }
+        if (hi >= 0x80) cls.ranges.emplace_back(std::max<char32_t>(lo, 0x80), hi);
+      }
+      g_.classes_.push_back(std::move(cls));
+    }
+  }
+
+  // the closure of an instruction: itself and everything it reaches without input.
+  // every epsilon move goes forward, so one backward pass fills the table
+  void closures() {
+    size_t n = g_.prog_.size();
+    size_t w = g_.words_ = (n + 1 + 63) / 64;
+    g_.closure_.assign((n + 1) * w, 0);
+    auto row = [&](size_t i) { return &g_.closure_[i * w]; };
+    auto merge = [&](size_t into, size_t from) {
+      for (size_t k = 0; k < w; ++k) row(into)[k] |= row(from)[k];
+    };
+    row(n)[n / 64] |= uint64_t(1) << (n % 64);
+    for (size_t i = n; i-- > 0;) {
+      row(i)[i / 64] |= uint64_t(1) << (i % 64);
+      const Glob::Inst& in = g_.prog_[i];
+      switch (in.op) {
+      case Glob::kSplit:
+        merge(i, i + 1);
+        merge(i, in.arg);
+        break;
+      case Glob::kJump:
+        merge(i, in.arg);
+        break;
+      case Glob::kLoop:
+      case Glob::kLoopAll:
+        merge(i, i + 1);
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  // subset construction over the ASCII byte classes. gives up past kMaxStates, the NFA then
+  // does all the matching
+  void dfa() {
+    constexpr size_t kMaxStates = 256;
+    if (g_.words_ != 1) return;
+    const size_t n = g_.prog_.size();
+
+    // bytes that every instruction treats the same way go into one class.
+    // one word is enough for the signature, the program has fewer than 64 instructions
+    std::unordered_map<uint64_t, uint8_t> signatures;
+    std::vector<char32_t> reps;
+    for (char32_t b = 0; b < 0x80; ++b) {
+      char32_t c = g_.options_.case_sensitive ? b : fold(b);
+      uint64_t sig = 0;
+      for (size_t i = 0; i < n; ++i) sig |= uint64_t(g_.consumes(g_.prog_[i], c)) << i;
+      auto [it, added] = signatures.emplace(sig, static_cast<uint8_t>(reps.size()));
+      if (added) reps.push_back(c);
+      g_.byte_class_[b] = it->second;
+    }
+    const size_t k = reps.size();
+
+    std::unordered_map<uint64_t, int32_t> ids;
+    std::vector<uint64_t> sets = {g_.closure_[0]};
+    std::vector<int32_t> table;
+    ids.emplace(sets[0], 0);
+    for (size_t s = 0; s < sets.size(); ++s) {
+      for (size_t c = 0; c < k; ++c) {
+        uint64_t next = g_.step(sets[s], reps[c]);
+        if (next == 0) {
+          table.push_back(-1);
+          continue;
+        }
+        auto [it, added] = ids.emplace(next, static_cast<int32_t>(sets.size()));
+        if (added) {
+          if (sets.size() == kMaxStates) return;
+          sets.push_back(next);
+        }
+        table.push_back(it->second);
+      }
+    }
+    g_.dfa_ = std::move(table);
+    g_.dfa_sets_ = std::move(sets);
+    g_.alphabet_ = k;
+  }
+
+  // a literal with stars only at the ends needs no program
+  bool literal_shape(const Seq& seq) {
+    size_t lead = 0, trail = 0;
+    while (lead < seq.size() && seq[lead].kind == Node::kStar) ++lead;
+    while (trail < seq.size() - lead && seq[seq.size() - 1 - trail].kind == Node::kStar) ++trail;
+    std::string literal;
+    for (size_t i = lead; i < seq.size() - trail; ++i) {
+      if (seq[i].kind != Node::kChar) return false;
+      append_utf8(literal, g_.options_.case_sensitive ? seq[i].c : fold(seq[i].c));
+    }
+    if (lead && trail) {
+      // in path mode the stars may not cross a '/', which the byte search does not check
+      if (g_.options_.path) return false;
+      g_.shape_ = Glob::Shape::substring;
+    } else {
+      g_.shape_ = lead ? Glob::Shape::suffix : trail ? Glob::Shape::prefix : Glob::Shape::exact;
+    }
+    g_.literal_ = std::move(literal);
+    return true;
+  }
+
+private:
+  size_t push(Glob::Op op, uint32_t arg) {
+    g_.prog_.push_back(Glob::Inst{op, arg});
+    return g_.prog_.size() - 1;
+  }
+  uint32_t here() const { return static_cast<uint32_t>(g_.prog_.size()); }
+
+  static void set_ascii(Glob::CharClass& cls, char32_t c) { cls.ascii[c / 64] |= uint64_t(1) << (c % 64); }
+
+  Glob& g_;
+};
+
+bool Glob::CharClass::contains(char32_t c) const {
+  bool in = false;
+  if (c < 0x80) {
+    in = (ascii[c / 64] >> (c % 64)) & 1;
+  } else {
+    for (auto [lo, hi] : ranges) {
+      if (lo <= c && c <= hi) {
+        in = true;
+        break;
+      }
+    }
+  }
+  return in != negate;
+}
+
+Glob::Glob(std::string_view pattern, const GlobOptions& options) : options_(options) {
+  Parser parser(pattern, options);
+  Seq seq = parser.parse();
+  GlobCompiler compiler(*this);
+  if (compiler.literal_shape(seq)) return;
+  compiler.add_classes(parser.classes);
+  compiler.emit(seq);
+  compiler.closures();
+  compiler.dfa();
+}
+
+bool Glob::literal_matches(std::string_view s) const {
+  const size_t n = literal_.size();
+  if (s.size() < n) return false;
+  // where the literal has to be, the rest is what a star covers
+  const char* at = s.data();
+  switch (shape_) {
+  case Shape::exact:
+    if (s.size() != n) return false;
+    break;
+  case Shape::prefix:
+    break;
+  case Shape::suffix:
+    at = s.data() + s.size() - n;
+    break;
+  case Shape::substring:
+    if (n == 0) return true;
+    // string_view::find ends up in memchr/memcmp, both vectorized in libc
+    return options_.case_sensitive ? s.find(literal_) != std::string_view::npos : find_fold(s, literal_);
+  case Shape::program:
+    return false;
+  }
+  bool equal = options_.case_sensitive ? std::memcmp(at, literal_.data(), n) == 0 : equal_fold(at, literal_.data(), n);
+  // no branch on the result outside path mode, a name list matches about at random
+  if (!options_.path) return equal;
+  // the part a star covers may not hold a '/'
+  const char* rest = shape_ == Shape::prefix ? s.data() + n : s.data();
+  return equal && std::memchr(rest, '/', s.size() - n) == nullptr;
+}
+
+inline bool Glob::consumes(const Inst& in, char32_t c) const {
+  switch (in.op) {
+  case kChar: return c == in.arg;
+  case kAny:
+  case kLoop: return !(options_.path && c == '/');
+  case kClass: return !(options_.path && c == '/') && classes_[in.arg].contains(c);
+  case kLoopAll: return true;
+  default: return false;
+  }
+}
+
+bool Glob::run_program(std::string_view s) const {
+  if (!dfa_.empty()) return run_dfa(s);
+  return words_ == 1 ? run_narrow(s, 0, closure_[0]) : run_wide(s);
+}
+
+// up to 63 instructions: the state set is one word. c is already folded
+uint64_t Glob::step(uint64_t cur, char32_t c) const {
+  const size_t n = prog_.size();
+  uint64_t next = 0;
+  for (uint64_t live = cur & ~(uint64_t(1) << n); live; live &= live - 1) {
+    size_t i = static_cast<size_t>(__builtin_ctzll(live));
+    const Inst& in = prog_[i];
+    if (!consumes(in, c)) continue;
+    // a loop stays where it is, everything else moves on
+    next |= closure_[in.op == kLoop || in.op == kLoopAll ? i : i + 1];
+  }
+  return next;
+}
+
+bool Glob::run_dfa(std::string_view s) const {
+  int32_t state = 0;
+  for (size_t pos = 0; pos < s.size(); ++pos) {
+    unsigned char b = static_cast<unsigned char>(s[pos]);
+    // the DFA only knows ASCII, the NFA takes over from the same set of states
+    if (b >= 0x80) return run_narrow(s, pos, dfa_sets_[state]);
+    state = dfa_[state * alphabet_ + byte_class_[b]];
+    if (state < 0) return false;
+  }
+  return (dfa_sets_[state] >> prog_.size()) & 1;
+}
+
+bool Glob::run_narrow(std::string_view s, size_t pos, uint64_t cur) const {
+  while (pos < s.size()) {
+    char32_t c = next_char(s, pos);
+    if (!options_.case_sensitive) c = fold(c);
+    cur = step(cur, c);
+    if (cur == 0) return false;
+  }
+  return (cur >> prog_.size()) & 1;
+}
+
+bool Glob::run_wide(std::string_view s) const {
+  const size_t n = prog_.size();
+  const size_t w = words_;
+  thread_local std::vector<uint64_t> cur, next;
+  cur.assign(closure_.begin(), closure_.begin() + w);
+  next.resize(w);
+  for (size_t pos = 0; pos < s.size();) {
+    char32_t c = next_char(s, pos);
+    if (!options_.case_sensitive) c = fold(c);
+    std::fill(next.begin(), next.end(), 0);
+    bool any = false;
+    for (size_t k = 0; k < w; ++k) {
+      for (uint64_t live = cur[k]; live; live &= live - 1) {
+        size_t i = k * 64 + static_cast<size_t>(__builtin_ctzll(live));
+        if (i == n) continue;
+        const Inst& in = prog_[i];
+        if (!consumes(in, c)) continue;
+        const uint64_t* row = &closure_[(in.op == kLoop || in.op == kLoopAll ? i : i + 1) * w];
+        for (size_t m = 0; m < w; ++m) next[m] |= row[m];
+        any = true;
+      }
+    }
+    if (!any) return false;
+    cur.swap(next);
+  }
+  return (cur[n / 64] >> (n % 64)) & 1;
+}
+
+namespace {
+void append_re2_char(std::string& out, char32_t c) {
+  if (c < 0x80 && !std::isalnum(static_cast<unsigned char>(c)) && c != '_') {
+    // RE2 takes a backslash before any ASCII punctuation, \x{..} for the control characters
+    if (c < 0x20 || c == 0x7F) {
+      char buf[16];
+      std::snprintf(buf, sizeof(buf), "\\x{%x}", static_cast<unsigned>(c));
+      out += buf;
+      return;
+    }
+    out += '\\';
+  }
+  append_utf8(out, c);
+}
+
+void append_re2(std::string& out, const Seq& seq, const std::vector<ParsedClass>& classes, const GlobOptions& options) {
+  for (const Node& n : seq) {
+    switch (n.kind) {
+    case Node::kChar:
+      append_re2_char(out, n.c);
+      break;
+    case Node::kAny:
+      out += options.path ? "[^/]" : ".";
+      break;
+    case Node::kClass: {
+      const ParsedClass& cls = classes[n.cls];
+      out += cls.negate ? (options.path ? "[^/" : "[^") : "[";
+      auto append_range = [&out](char32_t lo, char32_t hi) {
+        append_re2_char(out, lo);
+        if (hi != lo) {
+          out += '-';
+          append_re2_char(out, hi);
+        }
+      };
+      bool members = false;
+      for (auto [lo, hi] : cls.ranges) {
+        // like the program, a class never matches '/' in path mode: the range is split around it
+        if (options.path && !cls.negate && lo <= '/' && '/' <= hi) {
+          if (lo < '/') append_range(lo, '/' - 1);
+          if (hi > '/') append_range('/' + 1, hi);
+          members = members || lo < '/' || hi > '/';
+          continue;
+        }
+        append_range(lo, hi);
+        members = true;
+      }
+      // [/] is left with nothing to match
+      if (!members && !cls.negate) out += "^\\x{0}-\\x{10ffff}";
+      out += ']';
+      break;
+    }
+    case Node::kStar:
+      out += options.path ? "[^/]*" : ".*";
+      break;
+    case Node::kAnyPath:
+      out += ".*";
+      break;
+    case Node::kDirs:
+      out += "(?:.*/)?";
+      break;
+    case Node::kAlt:
+      out += "(?:";
+      for (size_t a = 0; a < n.alts.size(); ++a) {
+        if (a) out += '|';
+        append_re2(out, n.alts[a], classes, options);
+      }
+      out += ')';
+      break;
+    }
+  }
+}
+}
+
+std::string glob_to_re2(std::string_view pattern, const GlobOptions& options) {
+  Parser parser(pattern, options);
+  Seq seq = parser.parse();
+  // s: '.' also matches a newline, a file name may have one
+  std::string out = options.case_sensitive ? "(?s)" : "(?si)";
+  append_re2(out, seq, parser.classes, options);
+  return out;
+}
+
+}
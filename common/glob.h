@@ -0,0 +1,91 @@
+#ifndef GLOB_H_
+#define GLOB_H_
+// Native glob matching, no regex engine in between.
+// A pattern is parsed once and compiled to a small bytecode program, an NFA over the UTF-8
+// characters of the name: the live instructions are a bitset and the epsilon moves (alternatives,
+// the optional "**/") are folded into precomputed closures. When the program is small, its DFA
+// over ASCII is built up front too, so an ASCII name costs one table lookup per byte; a non ASCII
+// character hands over to the NFA. A literal with a star on one or both sides skips all of that
+// and compares bytes.
+//
+// Syntax: * ? [a-z] [!a-z] [^a-z] [[:alpha:]] \x {a,b} (nested), and with path semantics
+// gitignore's "**/", "/**/" and trailing "/**". An unterminated [ or { is a literal.
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace gutils {
+
+struct GlobOptions {
+  bool case_sensitive = true;  // off: ASCII letters only, NameMatcher keeps RE2 for the rest
+  bool path = false;           // '/' separates components: * ? [] do not match it, ** does
+  bool braces = true;          // {a,b}. gitignore has none, braces are literal there
+};
+
+class Glob {
+public:
+  explicit Glob(std::string_view pattern, const GlobOptions& options = GlobOptions());
+
+  // the whole string has to match
+  bool matches(std::string_view s) const { return shape_ != Shape::program ? literal_matches(s) : run_program(s); }
+
+  // instructions in the program, 0 when a byte compare does the matching
+  size_t program_size() const { return prog_.size(); }
+  // states of the ASCII DFA, 0 when there is none
+  size_t dfa_size() const { return dfa_sets_.size(); }
+
+private:
+  friend class GlobCompiler;
+
+  enum class Shape { program, exact, prefix, suffix, substring };
+  enum Op : uint8_t {
+    kChar,     // arg is the character
+    kAny,      // one character
+    kClass,    // arg indexes classes_
+    kLoop,     // any number of characters, '/' excluded in path mode
+    kLoopAll,  // any number of characters, '/' included
+    kSplit,    // no input, continue at the next instruction and at arg
+    kJump,     // no input, continue at arg
+  };
+  struct Inst {
+    Op op;
+    uint32_t arg;
+  };
+  struct CharClass {
+    bool negate = false;
+    uint64_t ascii[2] = {0, 0};
+    std::vector<std::pair<char32_t, char32_t>> ranges;  // members above ASCII
+
+    bool contains(char32_t c) const;
+  };
+
+  bool literal_matches(std::string_view s) const;
+  bool run_program(std::string_view s) const;
+  bool consumes(const Inst& in, char32_t c) const;
+  uint64_t step(uint64_t cur, char32_t c) const;
+  bool run_dfa(std::string_view s) const;
+  bool run_narrow(std::string_view s, size_t pos, uint64_t cur) const;
+  bool run_wide(std::string_view s) const;
+
+  GlobOptions options_;
+  Shape shape_ = Shape::program;
+  std::string literal_;  // Shape::exact .. substring, ASCII folded when !case_sensitive
+  std::vector<Inst> prog_;
+  std::vector<CharClass> classes_;
+  size_t words_ = 1;               // bitset words per state set
+  std::vector<uint64_t> closure_;  // words_ per instruction, plus the accept state
+  // the DFA, only for programs whose state set is one word
+  std::vector<int32_t> dfa_;        // next state per state and byte class, -1 is no match
+  std::vector<uint64_t> dfa_sets_;  // the NFA states behind each DFA state
+  uint8_t byte_class_[128] = {};    // ASCII bytes that no instruction tells apart share a class
+  size_t alphabet_ = 0;
+};
+
+// the same pattern as an RE2 regex for the whole string, for what Glob does not do
+// (case folding beyond ASCII)
+std::string glob_to_re2(std::string_view pattern, const GlobOptions& options = GlobOptions());
+
+}
+#endif // GLOB_H_
@@ -9,7 +9,6 @@
 
 #include <re2/re2.h>
 namespace gutils {
-  std::string glob_to_regex(std::string_view glob);
   // void hello();
   template <typename T>
   bool vector_contains(const std::vector<T>& vec, const T& value){
@@ -23,6 +22,4 @@ namespace gutils {
 
   std::string_view get_last_third_part(std::string_view s);
 std::string get_today();
-
-std::vector<std::unique_ptr<RE2>> load_gitignore_rules(const std::filesystem::path& dir);
 }
@@ -0,0 +1,203 @@
+#include "metafilter.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <pwd.h>
+
+namespace gutils {
+
+namespace {
+enum TypeBit : unsigned {
+  kFile = 1, kDir = 2, kLink = 4, kPipe = 8, kSocket = 16, kExec = 32,
+};
+
+std::string lower(std::string_view s) {
+  std::string out(s);
+  for (char& c : out) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  return out;
+}
+
+// leading digits of s into n, the rest of s is the unit
+bool split_number(std::string_view s, uint64_t& n, std::string& unit) {
+  size_t i = 0;
+  n = 0;
+  while (i < s.size() && s[i] >= '0' && s[i] <= '9') n = n * 10 + (s[i++] - '0');
+  if (i == 0) return false;
+  unit = lower(s.substr(i));
+  return true;
+}
+
+bool resolve_user(const std::string& s, uid_t& uid) {
+  if (!s.empty() && s.find_first_not_of("0123456789") == std::string::npos) {
+    uid = static_cast<uid_t>(std::stoul(s));
+    return true;
+  }
+  struct passwd* pw = ::getpwnam(s.c_str());
+  if (pw == nullptr) return false;
+  uid = pw->pw_uid;
+  return true;
+}
+
+bool resolve_group(const std::string& s, gid_t& gid) {
+  if (!s.empty() && s.find_first_not_of("0123456789") == std::string::npos) {
+    gid = static_cast<gid_t>(std::stoul(s));
+    return true;
+  }
+  struct group* gr = ::getgrnam(s.c_str());
+  if (gr == nullptr) return false;
+  gid = gr->gr_gid;
+  return true;
+}
+}
+
+bool MetaFilter::add_type(std::string_view spec, std::string& error) {
+  std::string s = lower(spec);
+  if (s == "f" || s == "file") types_ |= kFile;
+  else if (s == "d" || s == "dir" || s == "directory") types_ |= kDir;
+  else if (s == "l" || s == "symlink") types_ |= kLink;
+  else if (s == "p" || s == "pipe") types_ |= kPipe;
+  else if (s == "s" || s == "socket") types_ |= kSocket;
+  else if (s == "x" || s == "executable") {
+    types_ |= kExec;
+    mask_ |= STATX_MODE;
+  } else {
+    error = "unknown type '" + std::string(spec) + "', expected f, d, l, p, s or x";
+    return false;
+  }
+  return true;
+}
+
+bool MetaFilter::add_size(std::string_view spec, std::string& error) {
+  SizeBound b{0, 0};
+  if (!spec.empty() && (spec[0] == '+' || spec[0] == '-')) {
+    b.cmp = spec[0] == '+' ? 1 : -1;
+    spec.remove_prefix(1);
+  }
+  uint64_t n;
+  std::string unit;
+  if (!split_number(spec, n, unit)) {
+    error = "size '" + std::string(spec) + "' does not start with a number";
+    return false;
+  }
+  static const std::pair<const char*, uint64_t> kUnits[] = {
+      {"", 1}, {"b", 1},
+      {"k", 1000ull}, {"m", 1000ull * 1000}, {"g", 1000ull * 1000 * 1000}, {"t", 1000ull * 1000 * 1000 * 1000},
+      {"ki", 1ull << 10}, {"mi", 1ull << 20}, {"gi", 1ull << 30}, {"ti", 1ull << 40},
+  };
+  for (auto& [name, factor] : kUnits) {
+    if (unit == name) {
+      b.bytes = n * factor;
+      sizes_.push_back(b);
+      mask_ |= STATX_SIZE;
+      return true;
+    }
+  }
+  error = "unknown size unit '" + unit + "'";
+  return false;
+}
+
+bool MetaFilter::set_changed_within(std::string_view spec, std::string& error) {
+  uint64_t n;
+  std::string unit;
+  if (!split_number(spec, n, unit)) {
+    error = "duration '" + std::string(spec) + "' does not start with a number";
+    return false;
+  }
+  static const std::pair<const char*, uint64_t> kUnits[] = {
+      {"", 1}, {"s", 1}, {"sec", 1}, {"min", 60}, {"m", 60}, {"h", 3600},
+      {"d", 86400}, {"w", 7 * 86400},
+  };
+  for (auto& [name, factor] : kUnits) {
+    if (unit == name) {
+      changed_after_ = ::time(nullptr) - static_cast<time_t>(n * factor);
+      has_changed_ = true;
+      mask_ |= STATX_MTIME;
+      return true;
+    }
+  }
+  error = "unknown duration unit '" + unit + "'";
+  return false;
+}
+
+bool MetaFilter::set_owner(std::string_view spec, std::string& error) {
+  size_t colon = spec.find(':');
+  std::string user(spec.substr(0, colon));
+  std::string group = colon == std::string_view::npos ? "" : std::string(spec.substr(colon + 1));
+  if (!user.empty()) {
+    if (!resolve_user(user, uid_)) {
+      error = "unknown user '" + user + "'";
+      return false;
+    }
+    has_uid_ = true;
+    mask_ |= STATX_UID;
+  }
+  if (!group.empty()) {
+    if (!resolve_group(group, gid_)) {
+      error = "unknown group '" + group + "'";
+      return false;
+    }
+    has_gid_ = true;
+    mask_ |= STATX_GID;
+  }
+  if (!has_uid_ && !has_gid_) {
+    error = "empty owner";
+    return false;
+  }
+  return true;
+}
+
+bool MetaFilter::type_ok(unsigned char d_type) const {
+  if (types_ == 0) return true;
+  switch (d_type) {
+    // x is only known after the stat, a regular file is a candidate for it
+    case DT_REG: return types_ & (kFile | kExec);
+    case DT_DIR: return types_ & kDir;
+    case DT_LNK: return types_ & kLink;
+    case DT_FIFO: return types_ & kPipe;
+    case DT_SOCK: return types_ & kSocket;
+    default: return false;
+  }
+}
+
+bool MetaFilter::stat_ok(const struct statx& st) const {
+  // a regular file that got past type_ok only because of x has to be executable
+  if ((types_ & kExec) && !(types_ & kFile) && S_ISREG(st.stx_mode) &&
+      !(st.stx_mode & (S_IXUSR | S_IXGRP | S_IXOTH))) {
+    return false;
+  }
+  for (const auto& b : sizes_) {
+    if (b.cmp > 0 ? st.stx_size < b.bytes : b.cmp < 0 ? st.stx_size > b.bytes : st.stx_size != b.bytes) {
+      return false;
+    }
+  }
+  if (has_changed_ && st.stx_mtime.tv_sec < changed_after_) return false;
+  if (has_uid_ && st.stx_uid != uid_) return false;
+  if (has_gid_ && st.stx_gid != gid_) return false;
+  return true;
+}
+
+bool MetaFilter::stat_matches(int dir_fd, const char* name, int& err) const {
+  struct statx st;
+  err = 0;
+  if (::statx(dir_fd, name, stat_flags(), stat_mask(), &st) != 0) {
+    err = errno;
+    return false;
+  }
+  return stat_ok(st);
+}
+
+void StatBatch::stat_all() {
+  if (ring_ && reqs_.size() > 1 && ring_->run(reqs_, filter_.stat_mask(), filter_.stat_flags())) return;
+  // one at a time: no ring, a single entry, or the ring failed
+  for (auto& r : reqs_) {
+    r.err = ::statx(r.dir_fd, r.name, filter_.stat_flags(), filter_.stat_mask(), r.out) == 0
+        ? 0 : errno;
+  }
+}
+
+}
@@ -0,0 +1,122 @@
+#ifndef METAFILTER_H_
+#define METAFILTER_H_
+// Metadata predicates for the fd tools: --type, --size, --changed-within, --owner.
+// They run after the name check. The type is taken from d_type where possible; only when a
+// predicate needs more, the entry is stat'ed, with statx and just the fields that are needed.
+// StatBatch collects the candidates of one directory and stats them together, over io_uring
+// when a StatxRing is available.
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "statxring.h"
+
+namespace gutils {
+
+class MetaFilter {
+public:
+  // the parse functions return false and set error for a malformed value.
+  // --type f|d|l|p|s|x, may be given more than once. x is an executable regular file
+  bool add_type(std::string_view spec, std::string& error);
+  // --size [+-]N[unit]: + at least, - at most, neither: exactly. b, k, m, g, t are powers of 1000,
+  // ki, mi, gi, ti powers of 1024. case does not matter
+  bool add_size(std::string_view spec, std::string& error);
+  // --changed-within N[unit]: modified less than that long ago. s, min, h, d, w, plain N is seconds
+  bool set_changed_within(std::string_view spec, std::string& error);
+  // --owner user, user:group or :group, names or numeric ids
+  bool set_owner(std::string_view spec, std::string& error);
+
+  // --follow: stat what a symlink points to, not the link
+  void set_follow(bool follow) { follow_ = follow; }
+  int stat_flags() const { return (follow_ ? 0 : AT_SYMLINK_NOFOLLOW) | AT_STATX_DONT_SYNC; }
+
+  // statx fields the caller needs on top of the predicates' (--dedupe: size and inode)
+  void require(unsigned mask) { mask_ |= mask; }
+
+  bool active() const { return types_ != 0 || mask_ != 0; }
+  // true when the d_type check is not enough
+  bool needs_stat() const { return mask_ != 0; }
+  unsigned stat_mask() const { return mask_ | STATX_TYPE; }
+
+  // the cheap part, d_type of the entry (DT_UNKNOWN already resolved)
+  bool type_ok(unsigned char d_type) const;
+  // the rest, on the result of a statx with stat_mask()
+  bool stat_ok(const struct statx& st) const;
+
+  // statx of name relative to dir_fd, then stat_ok. err is 0 or the errno of the statx
+  bool stat_matches(int dir_fd, const char* name, int& err) const;
+
+private:
+  unsigned types_ = 0;       // bit per --type letter
+  unsigned mask_ = 0;        // statx fields the predicates need
+  bool follow_ = false;
+
+  struct SizeBound {
+    int cmp;                 // -1 at most, 0 exactly, +1 at least
+    uint64_t bytes;
+  };
+  std::vector<SizeBound> sizes_;
+  time_t changed_after_ = 0;  // mtime has to be newer than this, 0 for no limit
+  bool has_changed_ = false;
+  bool has_uid_ = false;
+  bool has_gid_ = false;
+  uid_t uid_ = 0;
+  gid_t gid_ = 0;
+};
+
+// The candidates of one directory that passed the name and type checks but need a stat.
+// Names are copied, so they outlive the DirReader buffer they came from.
+class StatBatch {
+public:
+  StatBatch(const MetaFilter& filter, StatxRing* ring) : filter_(filter), ring_(ring) {}
+
+  void add(std::string_view name) {
+    offsets_.push_back(names_.size());
+    names_.append(name.data(), name.size());
+    names_ += '\0';
+  }
+  bool empty() const { return offsets_.empty(); }
+
+  // stat everything added relative to dir_fd, call on_match(name, statx) for the entries
+  // that pass the filter and on_error(name, errno) for failed stats. clears the batch
+  template <typename F, typename E>
+  void run(int dir_fd, F&& on_match, E&& on_error) {
+    size_t n = offsets_.size();
+    results_.resize(n);
+    reqs_.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+      reqs_[i] = StatxRequest{dir_fd, names_.data() + offsets_[i], &results_[i], 0};
+    }
+    stat_all();
+    for (size_t i = 0; i < n; ++i) {
+      std::string_view name(names_.data() + offsets_[i]);
+      if (reqs_[i].err != 0) {
+        on_error(name, reqs_[i].err);
+      } else if (filter_.stat_ok(results_[i])) {
+        on_match(name, results_[i]);
+      }
+    }
+    offsets_.clear();
+    names_.clear();
+  }
+
+private:
+  void stat_all();
+
+  const MetaFilter& filter_;
+  StatxRing* ring_;
+  std::string names_;
+  std::vector<size_t> offsets_;
+  std::vector<struct statx> results_;
+  std::vector<StatxRequest> reqs_;
+};
+
+}
+#endif // METAFILTER_H_
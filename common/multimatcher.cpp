@@ -0,0 +1,85 @@
+#include "multimatcher.h"
+
+#include <algorithm>
+
+namespace gutils {
+
+TaggedPattern parse_tagged_pattern(std::string_view spec, size_t id) {
+  size_t eq = spec.rfind('=');
+  if (eq == std::string_view::npos) return TaggedPattern{std::string(spec), std::to_string(id)};
+  // "a=b=": the pattern a=b with the default tag
+  std::string tag(spec.substr(eq + 1));
+  return TaggedPattern{std::string(spec.substr(0, eq)), tag.empty() ? std::to_string(id) : tag};
+}
+
+MultiMatcher::MultiMatcher(std::vector<TaggedPattern> patterns, bool case_sensitive)
+    : patterns_(std::move(patterns)) {
+  std::vector<int> wild;
+  for (size_t i = 0; i < patterns_.size(); ++i) {
+    NameMatcher m(patterns_[i].glob, case_sensitive);
+    if (!m.ok()) {
+      error_ = patterns_[i].glob + ": " + m.error();
+      return;
+    }
+    // real wildcards, the rest has a byte compare or needs RE2 for non ASCII folding
+    if (m.kind() == GlobKind::glob) {
+      wild.push_back(static_cast<int>(i));
+    } else {
+      single_.emplace_back(static_cast<int>(i), std::move(m));
+    }
+  }
+  if (wild.size() < 2) {
+    for (int i : wild) single_.emplace_back(i, NameMatcher(patterns_[i].glob, case_sensitive));
+    std::sort(single_.begin(), single_.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    return;
+  }
+
+  RE2::Options options;
+  options.set_case_sensitive(case_sensitive);
+  options.set_log_errors(false);
+  set_ = std::make_unique<RE2::Set>(options, RE2::ANCHOR_BOTH);
+  GlobOptions glob_options;
+  glob_options.case_sensitive = case_sensitive;
+  for (int i : wild) {
+    const std::string& glob = patterns_[i].glob;
+    std::string err;
+    if (set_->Add(glob_to_re2(glob, glob_options), &err) < 0) {
+      error_ = glob + ": " + err;
+      return;
+    }
+    set_ids_.push_back(i);
+  }
+  if (!set_->Compile()) error_ = "out of memory compiling the patterns";
+}
+
+bool MultiMatcher::match(std::string_view name, std::vector<int>& ids) const {
+  ids.clear();
+  for (const auto& [id, m] : single_) {
+    if (m.matches(name)) ids.push_back(id);
+  }
+  if (set_) {
+    thread_local std::vector<int> hits;
+    if (set_->Match(name, &hits)) {
+      for (int h : hits) ids.push_back(set_ids_[h]);
+      std::sort(ids.begin(), ids.end());
+    }
+  }
+  return !ids.empty();
+}
+
+void MultiMatcher::tags(const std::vector<int>& ids, std::string& out) const {
+  out.clear();
+  for (int id : ids) {
+    if (!out.empty()) out += ',';
+    out += patterns_[id].tag;
+  }
+}
+
+void MultiMatcher::tags_of(std::string_view name, std::string& out) const {
+  thread_local std::vector<int> ids;
+  match(name, ids);
+  tags(ids, out);
+}
+
+}
@@ -0,0 +1,52 @@
+#ifndef MULTIMATCHER_H_
+#define MULTIMATCHER_H_
+// -e pattern[=tag]: several name patterns, one walk.
+// Every name is matched against all patterns in one pass. The literal shapes ("*.core", "RG-*")
+// keep NameMatcher's byte compares, one per pattern. The patterns with real wildcards are compiled
+// together into one RE2::Set, so a name runs through a single DFA however many of them there are.
+// A lone wildcard pattern is not worth a set and stays a Glob.
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <re2/set.h>
+
+#include "namematcher.h"
+
+namespace gutils {
+
+struct TaggedPattern {
+  std::string glob;
+  std::string tag;  // printed for the matches, the pattern's id when not given
+};
+
+// "pattern[=tag]", the tag is what follows the last '=', so a pattern with a '=' in it needs a
+// tag or a trailing '=': "a=b=". id is the default tag, for an empty one too
+TaggedPattern parse_tagged_pattern(std::string_view spec, size_t id);
+
+class MultiMatcher {
+public:
+  MultiMatcher(std::vector<TaggedPattern> patterns, bool case_sensitive);
+
+  bool ok() const { return error_.empty(); }
+  const std::string& error() const { return error_; }
+  size_t size() const { return patterns_.size(); }
+
+  // ids of the patterns name matches, ascending, into ids. false when there are none
+  bool match(std::string_view name, std::vector<int>& ids) const;
+  // the tags of ids, comma separated, into out
+  void tags(const std::vector<int>& ids, std::string& out) const;
+  // match() and tags() in one, for results whose ids were not kept. empty when nothing matches
+  void tags_of(std::string_view name, std::string& out) const;
+
+private:
+  std::vector<TaggedPattern> patterns_;
+  std::vector<std::pair<int, NameMatcher>> single_;  // pattern id, matched on its own
+  std::unique_ptr<RE2::Set> set_;
+  std::vector<int> set_ids_;  // pattern id of each set entry
+  std::string error_;
+};
+
+}
+#endif // MULTIMATCHER_H_
@@ -0,0 +1,73 @@
+#include "namematcher.h"
+
+namespace gutils {
+
+namespace {
+bool is_wildcard(char c) {
+  return c == '*' || c == '?' || c == '[' || c == ']' || c == '{' || c == '}' || c == '\\';
+}
+
+bool is_ascii(std::string_view s) {
+  for (char c : s) {
+    if (static_cast<unsigned char>(c) >= 0x80) return false;
+  }
+  return true;
+}
+}
+
+GlobInfo analyze_glob(std::string_view glob) {
+  bool lead = !glob.empty() && glob.front() == '*';
+  bool trail = glob.size() > 1 && glob.back() == '*';
+  std::string_view body = glob.substr(lead, glob.size() - lead - trail);
+  for (char c : body) {
+    if (is_wildcard(c)) return GlobInfo{GlobKind::glob, std::string()};
+  }
+  if (body.empty()) {
+    // "*" or "**": everything matches
+    return GlobInfo{lead ? GlobKind::substring : GlobKind::exact, std::string()};
+  }
+  GlobKind kind = lead && trail ? GlobKind::substring
+                : lead          ? GlobKind::suffix
+                : trail         ? GlobKind::prefix
+                                : GlobKind::exact;
+  return GlobInfo{kind, std::string(body)};
+}
+
+const char* glob_kind_name(GlobKind kind) {
+  switch (kind) {
+  case GlobKind::exact: return "exact";
+  case GlobKind::prefix: return "prefix";
+  case GlobKind::suffix: return "suffix";
+  case GlobKind::substring: return "substring";
+  case GlobKind::glob: return "glob";
+  }
+  return "glob";
+}
+
+NameMatcher::NameMatcher(std::string_view glob, bool case_sensitive) {
+  bool has_wildcard = false;
+  for (char c : glob) has_wildcard = has_wildcard || is_wildcard(c);
+
+  GlobInfo info = has_wildcard ? analyze_glob(glob) : GlobInfo{GlobKind::substring, std::string(glob)};
+  kind_ = info.kind;
+  // RE2 folds non ASCII letters too, Glob only ASCII. keep RE2 for those instead of getting it subtly different
+  if (!case_sensitive && !is_ascii(glob)) {
+    GlobOptions options;
+    options.case_sensitive = false;
+    std::string regex_str = has_wildcard ? "^(?:" + glob_to_re2(glob, options) + ")$" : RE2::QuoteMeta(glob);
+    RE2::Options re2_options;
+    re2_options.set_case_sensitive(false);
+    regex_ = std::make_unique<RE2>(regex_str, re2_options);
+    return;
+  }
+  // the literal shapes are Glob's too, it compares bytes for them and runs no program
+  GlobOptions options;
+  options.case_sensitive = case_sensitive;
+  glob_ = std::make_unique<Glob>(has_wildcard ? std::string(glob) : "*" + std::string(glob) + "*", options);
+}
+
+bool NameMatcher::matches(std::string_view name) const {
+  return regex_ ? RE2::PartialMatch(name, *regex_) : glob_->matches(name);
+}
+
+}
@@ -0,0 +1,55 @@
+#ifndef NAMEMATCHER_H_
+#define NAMEMATCHER_H_
+// File name matching for the fd tools.
+// Most patterns are things like "*.log" or "RG-*": a literal with a star on one side.
+// Glob finds those shapes and matches them with plain byte comparisons, the rest runs its
+// program. analyze_glob reports the shape. RE2 is only left for case insensitive non ASCII patterns.
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <re2/re2.h>
+
+#include "glob.h"
+
+namespace gutils {
+
+enum class GlobKind {
+  exact,      // "foo"
+  prefix,     // "foo*"
+  suffix,     // "*.log"
+  substring,  // "*foo*"
+  glob,       // anything with ?, [, { or a star in the middle
+};
+
+struct GlobInfo {
+  GlobKind kind;
+  std::string literal;  // the text without the stars, empty for GlobKind::glob
+};
+
+// classify a glob, the whole name has to match it
+GlobInfo analyze_glob(std::string_view glob);
+
+const char* glob_kind_name(GlobKind kind);
+
+class NameMatcher {
+public:
+  // fd semantics: a pattern without any wildcard searches for a substring ("foo" is "*foo*"),
+  // a pattern with wildcards has to match the whole name
+  NameMatcher(std::string_view glob, bool case_sensitive);
+
+  bool ok() const { return !regex_ || regex_->ok(); }
+  std::string error() const { return regex_ ? regex_->error() : std::string(); }
+  // the shape of the pattern, also when RE2 matches it
+  GlobKind kind() const { return kind_; }
+
+  bool matches(std::string_view name) const;
+
+private:
+  GlobKind kind_;
+  std::unique_ptr<Glob> glob_;
+  std::unique_ptr<RE2> regex_;  // instead of glob_ when RE2 has to fold non ASCII letters
+};
+
+}
+#endif // NAMEMATCHER_H_
@@ -0,0 +1,92 @@
+#include "orderedemitter.h"
+
+#include <algorithm>
+
+namespace gutils {
+
+bool path_order_less(std::string_view a, std::string_view b) {
+  size_t n = std::min(a.size(), b.size());
+  for (size_t i = 0; i < n; ++i) {
+    if (a[i] == b[i]) continue;
+    // '/' ends a component, so it sorts before every other byte
+    unsigned char x = a[i] == '/' ? 0 : static_cast<unsigned char>(a[i]);
+    unsigned char y = b[i] == '/' ? 0 : static_cast<unsigned char>(b[i]);
+    return x < y;
+  }
+  return a.size() < b.size();
+}
+
+OrderedEmitter::NodePtr OrderedEmitter::Node::add(std::string_view name, bool matched, bool descend,
+                                                  std::string_view tag) {
+  NodePtr child;
+  if (descend) {
+    std::string child_dir = dir;
+    if (child_dir.empty() || child_dir.back() != '/') child_dir += '/';
+    child_dir += name;
+    child = std::make_shared<Node>(std::move(child_dir));
+  }
+  if (matched || descend) items.push_back(Item{std::string(name), matched, child, std::string(tag)});
+  return child;
+}
+
+OrderedEmitter::OrderedEmitter(OutputSink& sink) : out_(sink) {}
+
+OrderedEmitter::NodePtr OrderedEmitter::root(std::string dir) {
+  auto node = std::make_shared<Node>(std::move(dir));
+  std::lock_guard<std::mutex> lock(emit_m_);
+  stack_.push_back(Frame{node, 0});
+  return node;
+}
+
+void OrderedEmitter::complete(const NodePtr& node) {
+  std::sort(node->items.begin(), node->items.end(),
+            [](const Node::Item& a, const Node::Item& b) { return a.name < b.name; });
+  node->ready.store(true, std::memory_order_seq_cst);
+
+  // whoever holds the lock also picks up our node: it re-runs advance() when it sees dirty_.
+  // seq_cst throughout: a store(false) could overwrite the flag of a thread that just gave up, and
+  // with release/acquire the holder's ready loads could pass its reset and miss that thread's node
+  dirty_.store(true, std::memory_order_seq_cst);
+  while (true) {
+    std::unique_lock<std::mutex> lock(emit_m_, std::try_to_lock);
+    if (!lock.owns_lock()) return;
+    dirty_.exchange(false, std::memory_order_seq_cst);
+    advance();
+    lock.unlock();
+    if (!dirty_.load(std::memory_order_seq_cst)) return;
+  }
+}
+
+void OrderedEmitter::advance() {
+  while (!stack_.empty()) {
+    Frame& f = stack_.back();
+    if (!f.node->ready.load(std::memory_order_acquire)) return;
+    if (f.index == f.node->items.size()) {
+      stack_.pop_back();
+      continue;
+    }
+    Node::Item& item = f.node->items[f.index++];
+    if (item.matched) {
+      if (limit_ && !limit_->take()) {
+        // everything after this is dropped, the walk is being cancelled
+        stack_.clear();
+        return;
+      }
+      out_.add(f.node->dir, item.name, item.tag);
+    }
+    if (item.child) {
+      // the frame owns the child from now on, the parent's reference is dropped
+      NodePtr child = std::move(item.child);
+      stack_.push_back(Frame{std::move(child), 0});
+    }
+  }
+  out_.flush_if_stale();
+}
+
+void OrderedEmitter::finish() {
+  std::lock_guard<std::mutex> lock(emit_m_);
+  advance();
+  out_.flush();
+}
+
+}
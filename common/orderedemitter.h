@@ -0,0 +1,83 @@
+#ifndef ORDEREDEMITTER_H_
+#define ORDEREDEMITTER_H_
+// Deterministic output order for the threaded finders (--sorted).
+// Every directory the walk reads gets a Node. The worker puts the matches and the subdirectories
+// it will descend into the node, then calls complete(), which sorts the node by name.
+// The emitter walks the tree of nodes depth first in name order and writes a line as soon as every
+// node before it is complete. An emitted node is released right away, so memory is bounded by the
+// directories that are in flight or waiting for an earlier sibling, not by the result set.
+//
+// The order is by path component: "a", "a/b", "a.txt" ('/' sorts before any other byte),
+// the same for every run and every thread count.
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "outputsink.h"
+#include "resultlimit.h"
+
+namespace gutils {
+
+// the order the emitter writes in, for results that are sorted after the fact
+bool path_order_less(std::string_view a, std::string_view b);
+
+class OrderedEmitter {
+public:
+  struct Node;
+  using NodePtr = std::shared_ptr<Node>;
+
+  struct Node {
+    explicit Node(std::string d) : dir(std::move(d)) {}
+
+    // an entry of dir: matched is printed, a child is returned when the walk will descend into it
+    // (the same node has to be handed to the worker that reads that directory).
+    // tag is printed after the path, see OutputSink::Writer::add
+    NodePtr add(std::string_view name, bool matched, bool descend, std::string_view tag = {});
+
+  private:
+    friend class OrderedEmitter;
+    struct Item {
+      std::string name;
+      bool matched;
+      NodePtr child;
+      std::string tag;
+    };
+    std::string dir;
+    std::vector<Item> items;
+    std::atomic<bool> ready{false};
+  };
+
+  explicit OrderedEmitter(OutputSink& sink);
+
+  // --max-results: results are counted as they are written, in order. call before the walk starts
+  void set_limit(ResultLimit* limit) { limit_ = limit; }
+
+  // node of the start directory, call once
+  NodePtr root(std::string dir);
+
+  // the worker is done with node: sort it and write whatever became writable
+  void complete(const NodePtr& node);
+
+  // hand the remaining output to the sink, call before sink.close()
+  void finish();
+
+private:
+  struct Frame {
+    NodePtr node;
+    size_t index;
+  };
+
+  void advance();
+
+  OutputSink::Writer out_;
+  std::mutex emit_m_;
+  std::atomic<bool> dirty_{false};
+  std::vector<Frame> stack_;
+  ResultLimit* limit_ = nullptr;
+};
+
+}
+#endif // ORDEREDEMITTER_H_
@@ -0,0 +1,139 @@
+#include "outputsink.h"
+
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace gutils {
+
+namespace {
+std::atomic<uint64_t> g_next_sink_id{1};
+
+// writev until everything is out, handling short writes
+bool write_chunks(int fd, std::vector<iovec>& iov) {
+  size_t first = 0;
+  while (first < iov.size()) {
+    int count = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+    ssize_t n = ::writev(fd, iov.data() + first, count);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    size_t done = static_cast<size_t>(n);
+    while (first < iov.size() && done >= iov[first].iov_len) {
+      done -= iov[first].iov_len;
+      ++first;
+    }
+    if (done > 0) {
+      iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + done;
+      iov[first].iov_len -= done;
+    }
+  }
+  return true;
+}
+}
+
+OutputSink::Writer::Writer(OutputSink& sink) : sink_(sink) {
+  buf_.reserve(sink_.chunk_size_ + 4096);
+}
+
+OutputSink::Writer::~Writer() { flush(); }
+
+void OutputSink::Writer::flush() {
+  if (buf_.empty()) return;
+  sink_.submit(buf_, lines_);
+  lines_ = 0;
+}
+
+void OutputSink::Writer::flush_if_stale() {
+  if (!buf_.empty() && std::chrono::steady_clock::now() - first_ >= sink_.latency_) flush();
+}
+
+OutputSink::OutputSink(int fd, size_t chunk_size, int latency_ms)
+    : fd_(fd), chunk_size_(chunk_size), latency_(latency_ms),
+      id_(g_next_sink_id.fetch_add(1)), thread_(&OutputSink::run, this) {}
+
+OutputSink::OutputSink(Consumer consumer, size_t chunk_size, int latency_ms)
+    : fd_(-1), consumer_(std::move(consumer)), chunk_size_(chunk_size), latency_(latency_ms),
+      id_(g_next_sink_id.fetch_add(1)), thread_(&OutputSink::run, this) {}
+
+OutputSink::~OutputSink() { close(); }
+
+OutputSink::Writer& OutputSink::local() {
+  // the id, not the address, identifies the sink: a new sink may reuse the address of an old one
+  thread_local uint64_t cached_id = 0;
+  thread_local Writer* cached = nullptr;
+  if (cached_id != id_) {
+    auto writer = std::make_unique<Writer>(*this);
+    cached = writer.get();
+    cached_id = id_;
+    std::lock_guard<std::mutex> lock(writers_m_);
+    writers_.push_back(std::move(writer));
+  }
+  return *cached;
+}
+
+void OutputSink::submit(std::string& chunk, uint64_t lines) {
+  lines_.fetch_add(lines, std::memory_order_relaxed);
+  std::string next;
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    queue_.push_back(std::move(chunk));
+    if (!free_.empty()) {
+      next = std::move(free_.back());
+      free_.pop_back();
+    }
+  }
+  cv_.notify_one();
+  chunk = std::move(next);
+  chunk.clear();
+  if (chunk.capacity() < chunk_size_) chunk.reserve(chunk_size_ + 4096);
+}
+
+void OutputSink::run() {
+  std::deque<std::string> batch;
+  std::vector<iovec> iov;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_);
+      cv_.wait(lock, [this] { return closing_ || !queue_.empty(); });
+      if (queue_.empty() && closing_) return;
+      batch.swap(queue_);
+    }
+
+    bool ok = true;
+    if (consumer_) {
+      for (auto& chunk : batch) consumer_(chunk);
+    } else {
+      iov.clear();
+      for (auto& chunk : batch) iov.push_back(iovec{chunk.data(), chunk.size()});
+      ok = failed_ || write_chunks(fd_, iov);
+    }
+
+    std::lock_guard<std::mutex> lock(m_);
+    if (!ok) failed_ = true;
+    for (auto& chunk : batch) {
+      if (free_.size() < 64) free_.push_back(std::move(chunk));
+    }
+    batch.clear();
+  }
+}
+
+void OutputSink::flush() {
+  std::lock_guard<std::mutex> lock(writers_m_);
+  for (auto& w : writers_) w->flush();
+}
+
+void OutputSink::close() {
+  if (!thread_.joinable()) return;
+  flush();
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    closing_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+}
@@ -0,0 +1,115 @@
+#ifndef OUTPUTSINK_H_
+#define OUTPUTSINK_H_
+// Buffered result output for the threaded finders.
+// Every worker appends lines to its own Writer, no lock per match. A full buffer (or one that has
+// been sitting there for latency_ms) is handed to a single writer thread, which writes whatever has
+// queued up with one writev(2). Lines from one thread stay in order, lines are never torn.
+// Instead of an fd the sink can hand its chunks to a consumer, e.g. the exec stage of -x/-X.
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace gutils {
+
+class OutputSink {
+public:
+  class Writer {
+  public:
+    explicit Writer(OutputSink& sink);
+    ~Writer();
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    void add(std::string_view line) {
+      if (buf_.empty()) first_ = std::chrono::steady_clock::now();
+      buf_.append(line.data(), line.size());
+      buf_ += '\n';
+      ++lines_;
+      if (buf_.size() >= sink_.chunk_size_) flush();
+    }
+
+    // dir + '/' + name without building the path as a separate string first.
+    // a non empty tag follows after a tab (-e: the patterns that matched)
+    void add(std::string_view dir, std::string_view name, std::string_view tag = {}) {
+      if (buf_.empty()) first_ = std::chrono::steady_clock::now();
+      buf_.append(dir.data(), dir.size());
+      if (!dir.empty() && dir.back() != '/') buf_ += '/';
+      buf_.append(name.data(), name.size());
+      if (!tag.empty()) {
+        buf_ += '\t';
+        buf_.append(tag.data(), tag.size());
+      }
+      buf_ += '\n';
+      ++lines_;
+      if (buf_.size() >= sink_.chunk_size_) flush();
+    }
+
+    void flush();
+    // hand over a partly filled buffer once its oldest line is latency_ms old.
+    // cheap, call it whenever a worker finishes a directory
+    void flush_if_stale();
+
+  private:
+    OutputSink& sink_;
+    std::string buf_;
+    std::chrono::steady_clock::time_point first_;
+    uint64_t lines_ = 0;
+  };
+
+  // called on the writer thread with whole lines, each ending in '\n'
+  using Consumer = std::function<void(std::string_view chunk)>;
+
+  explicit OutputSink(int fd = 1, size_t chunk_size = 64 * 1024, int latency_ms = 20);
+  explicit OutputSink(Consumer consumer, size_t chunk_size = 64 * 1024, int latency_ms = 20);
+  ~OutputSink();
+  OutputSink(const OutputSink&) = delete;
+  OutputSink& operator=(const OutputSink&) = delete;
+
+  // Writer of the calling thread, created on first use. Meant for pool threads that outlive a search
+  Writer& local();
+
+  // hand the buffers of the writers created by local() to the writer thread without closing,
+  // e.g. between the initial pass of --watch and its events. all workers must be done adding lines
+  void flush();
+
+  // flush the writers created by local() and wait until everything is written.
+  // all workers must be done adding lines
+  void close();
+
+  // lines handed to flushed writers so far
+  uint64_t lines() const { return lines_.load(std::memory_order_relaxed); }
+
+private:
+  void submit(std::string& chunk, uint64_t lines);
+  void run();
+
+  int fd_;
+  Consumer consumer_;
+  size_t chunk_size_;
+  std::chrono::milliseconds latency_;
+  uint64_t id_;
+
+  std::mutex m_;
+  std::condition_variable cv_;
+  std::deque<std::string> queue_;
+  std::vector<std::string> free_;         // emptied buffers, reused to avoid reallocating
+  bool closing_ = false;
+  bool failed_ = false;                   // e.g. EPIPE, later chunks are dropped
+  std::atomic<uint64_t> lines_{0};
+
+  std::mutex writers_m_;
+  std::vector<std::unique_ptr<Writer>> writers_;
+  std::thread thread_;
+};
+
+}
+#endif // OUTPUTSINK_H_
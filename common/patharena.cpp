@@ -0,0 +1,96 @@
+#include "patharena.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace gutils {
+
+namespace {
+std::atomic<uint64_t> g_next_arena_id{1};
+
+// the name chunk a thread is currently filling, one per thread and arena
+struct NameSlab {
+  uint64_t arena = 0;
+  char* cur = nullptr;
+  char* end = nullptr;
+};
+}
+
+PathArena::PathArena(std::string_view root)
+    : arena_id_(g_next_arena_id.fetch_add(1)),
+      root_slash_(!root.empty() && root.back() == '/'),
+      blocks_(new std::atomic<Node*>[kMaxBlocks]) {
+  for (size_t i = 0; i < kMaxBlocks; ++i) blocks_[i].store(nullptr, std::memory_order_relaxed);
+  add(kRoot, root);
+}
+
+PathArena::~PathArena() = default;
+
+PathArena::Node* PathArena::block(size_t b) {
+  Node* p = blocks_[b].load(std::memory_order_acquire);
+  if (p != nullptr) return p;
+  std::lock_guard<std::mutex> lock(m_);
+  p = blocks_[b].load(std::memory_order_relaxed);
+  if (p == nullptr) {
+    owned_blocks_.push_back(std::make_unique<Node[]>(kBlockNodes));
+    p = owned_blocks_.back().get();
+    bytes_.fetch_add(kBlockNodes * sizeof(Node), std::memory_order_relaxed);
+    blocks_[b].store(p, std::memory_order_release);
+  }
+  return p;
+}
+
+const char* PathArena::store_name(std::string_view name) {
+  thread_local NameSlab slab;
+  if (slab.arena != arena_id_ || static_cast<size_t>(slab.end - slab.cur) < name.size()) {
+    size_t size = std::max(kNameChunk, name.size());
+    auto chunk = std::make_unique<char[]>(size);
+    slab.arena = arena_id_;
+    slab.cur = chunk.get();
+    slab.end = chunk.get() + size;
+    bytes_.fetch_add(size, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(m_);
+    chunks_.push_back(std::move(chunk));
+  }
+  char* p = slab.cur;
+  std::memcpy(p, name.data(), name.size());
+  slab.cur += name.size();
+  return p;
+}
+
+PathArena::Id PathArena::add(Id parent, std::string_view name) {
+  Id id = next_.fetch_add(1, std::memory_order_relaxed);
+  if ((id >> kBlockBits) >= kMaxBlocks) throw std::length_error("PathArena: too many directories");
+  Node& n = block(id >> kBlockBits)[id & (kBlockNodes - 1)];
+  n.name = store_name(name);
+  n.parent = parent;
+  n.len = static_cast<uint32_t>(name.size());
+  return id;
+}
+
+void PathArena::path(Id id, std::string& out) const {
+  // first the length, then fill from the back: no recursion, no temporary list of ancestors
+  size_t len = 0;
+  for (Id i = id;; i = node(i).parent) {
+    len += node(i).len;
+    if (i == kRoot) break;
+    if (node(i).parent != kRoot || !root_slash_) ++len;
+  }
+  out.resize(len);
+  char* p = out.data() + len;
+  for (Id i = id;; i = node(i).parent) {
+    const Node& n = node(i);
+    p -= n.len;
+    std::memcpy(p, n.name, n.len);
+    if (i == kRoot) break;
+    if (n.parent != kRoot || !root_slash_) *--p = '/';
+  }
+}
+
+std::string PathArena::path(Id id) const {
+  std::string out;
+  path(id, out);
+  return out;
+}
+
+}
@@ -0,0 +1,71 @@
+#ifndef PATHARENA_H_
+#define PATHARENA_H_
+// Directory paths of one traversal, stored as a tree: every node is its parent's index plus its
+// own name, the names live in big shared chunks. A queued directory is a 4 byte id instead of a
+// heap allocated full path, the full path is only put together when it is needed.
+// Nodes are never moved or freed before the arena goes away, so add() can run on any thread
+// while others read.
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gutils {
+
+class PathArena {
+public:
+  using Id = uint32_t;
+  static constexpr Id kRoot = 0;
+
+  explicit PathArena(std::string_view root);
+  ~PathArena();
+  PathArena(const PathArena&) = delete;
+  PathArena& operator=(const PathArena&) = delete;
+
+  // new child of parent, name is copied into the arena. thread safe
+  Id add(Id parent, std::string_view name);
+
+  Id parent(Id id) const { return node(id).parent; }
+  std::string_view name(Id id) const { const Node& n = node(id); return {n.name, n.len}; }
+
+  // full path of id into out (replacing its content), no allocation once out is big enough
+  void path(Id id, std::string& out) const;
+  std::string path(Id id) const;
+
+  size_t size() const { return next_.load(std::memory_order_relaxed); }
+  // bytes held by nodes and names
+  size_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+
+private:
+  struct Node {
+    const char* name;
+    Id parent;
+    uint32_t len;
+  };
+  static constexpr int kBlockBits = 14;                  // 16384 nodes, 256 KiB per block
+  static constexpr size_t kBlockNodes = size_t(1) << kBlockBits;
+  static constexpr size_t kMaxBlocks = size_t(1) << 16;  // up to 2^30 directories
+  static constexpr size_t kNameChunk = 64 * 1024;
+
+  const Node& node(Id id) const {
+    return blocks_[id >> kBlockBits].load(std::memory_order_acquire)[id & (kBlockNodes - 1)];
+  }
+  Node* block(size_t b);
+  const char* store_name(std::string_view name);
+
+  uint64_t arena_id_;
+  bool root_slash_;  // root ends in '/', no separator before its children
+  std::atomic<Id> next_{0};
+  std::atomic<size_t> bytes_{0};
+  std::unique_ptr<std::atomic<Node*>[]> blocks_;
+
+  std::mutex m_;  // new blocks and name chunks only
+  std::vector<std::unique_ptr<Node[]>> owned_blocks_;
+  std::vector<std::unique_ptr<char[]>> chunks_;
+};
+
+}
+#endif // PATHARENA_H_
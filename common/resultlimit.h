@@ -0,0 +1,34 @@
+#ifndef RESULTLIMIT_H_
+#define RESULTLIMIT_H_
+// --max-results / --first: a search stops once N results are out.
+// Every result takes a slot before it is written, the one that takes the last slot cancels the
+// search. Workers poll cancelled() between entries and stop descending.
+#include <atomic>
+#include <cstdint>
+
+namespace gutils {
+
+class ResultLimit {
+public:
+  // 0: no limit, take() always succeeds and nothing is ever cancelled
+  explicit ResultLimit(uint64_t max = 0) : max_(max) {}
+
+  // a slot for one result, false once all N are taken (the result is dropped)
+  bool take() {
+    if (max_ == 0) return true;
+    uint64_t n = taken_.fetch_add(1, std::memory_order_relaxed);
+    if (n + 1 >= max_) cancelled_.store(true, std::memory_order_release);
+    return n < max_;
+  }
+
+  bool cancelled() const { return cancelled_.load(std::memory_order_acquire); }
+  bool limited() const { return max_ != 0; }
+
+private:
+  uint64_t max_;
+  std::atomic<uint64_t> taken_{0};
+  std::atomic<bool> cancelled_{false};
+};
+
+}
+#endif // RESULTLIMIT_H_
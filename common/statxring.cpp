@@ -0,0 +1,164 @@
+#include "statxring.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace gutils {
+
+namespace {
+int io_uring_setup(unsigned entries, io_uring_params* p) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+unsigned* at(void* base, unsigned off) {
+  return reinterpret_cast<unsigned*>(static_cast<char*>(base) + off);
+}
+}
+
+std::unique_ptr<StatxRing> StatxRing::create(unsigned entries) {
+  io_uring_params p;
+  std::memset(&p, 0, sizeof(p));
+  int fd = io_uring_setup(entries, &p);
+  if (fd < 0) return nullptr;
+
+  std::unique_ptr<StatxRing> ring(new StatxRing());
+  ring->fd_ = fd;
+  ring->entries_ = p.sq_entries;
+
+  ring->sq_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  ring->cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+  bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+  if (single) ring->sq_size_ = ring->cq_size_ = std::max(ring->sq_size_, ring->cq_size_);
+
+  ring->sq_ptr_ = ::mmap(nullptr, ring->sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd, IORING_OFF_SQ_RING);
+  if (ring->sq_ptr_ == MAP_FAILED) {
+    ring->sq_ptr_ = nullptr;
+    return nullptr;
+  }
+  if (single) {
+    ring->cq_ptr_ = ring->sq_ptr_;
+  } else {
+    ring->cq_ptr_ = ::mmap(nullptr, ring->cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ptr_ == MAP_FAILED) {
+      ring->cq_ptr_ = nullptr;
+      return nullptr;
+    }
+  }
+  ring->sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+  ring->sqes_ = ::mmap(nullptr, ring->sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       fd, IORING_OFF_SQES);
+  if (ring->sqes_ == MAP_FAILED) {
+    ring->sqes_ = nullptr;
+    return nullptr;
+  }
+
+  ring->sq_head_ = at(ring->sq_ptr_, p.sq_off.head);
+  ring->sq_tail_ = at(ring->sq_ptr_, p.sq_off.tail);
+  ring->sq_mask_ = at(ring->sq_ptr_, p.sq_off.ring_mask);
+  ring->sq_array_ = at(ring->sq_ptr_, p.sq_off.array);
+  ring->cq_head_ = at(ring->cq_ptr_, p.cq_off.head);
+  ring->cq_tail_ = at(ring->cq_ptr_, p.cq_off.tail);
+  ring->cq_mask_ = at(ring->cq_ptr_, p.cq_off.ring_mask);
+  ring->cqes_ = static_cast<char*>(ring->cq_ptr_) + p.cq_off.cqes;
+
+  // IORING_OP_STATX needs 5.6, older kernels have io_uring without it
+  struct statx st;
+  std::vector<StatxRequest> probe{{AT_FDCWD, "/", &st, 0}};
+  if (!ring->run(probe, STATX_TYPE) || probe[0].err != 0) return nullptr;
+  return ring;
+}
+
+StatxRing::~StatxRing() {
+  if (sqes_) ::munmap(sqes_, sqes_size_);
+  if (cq_ptr_ && cq_ptr_ != sq_ptr_) ::munmap(cq_ptr_, cq_size_);
+  if (sq_ptr_) ::munmap(sq_ptr_, sq_size_);
+  if (fd_ >= 0) ::close(fd_);
+}
+
+void StatxRing::drain(unsigned tail, unsigned n, unsigned done) {
+  broken_ = true;
+  // the kernel moves the head past what it has consumed, the rest goes when the tail goes back
+  unsigned submitted = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) - tail;
+  if (submitted > n) submitted = n;
+  __atomic_store_n(sq_tail_, tail + submitted, __ATOMIC_RELEASE);
+  while (done < submitted) {
+    unsigned head = *cq_head_;
+    unsigned ctail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != ctail; ++head) ++done;
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    if (done >= submitted) break;
+    if (io_uring_enter(fd_, 0, submitted - done, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR &&
+        errno != EAGAIN && errno != EBUSY) {
+      // nothing left to wait with. the ring stays open and the thread owning it keeps it
+      return;
+    }
+  }
+}
+
+bool StatxRing::run(std::vector<StatxRequest>& reqs, unsigned mask, int flags) {
+  if (broken_) {
+    for (auto& r : reqs) r.err = EIO;
+    return false;
+  }
+  auto* sqes = static_cast<io_uring_sqe*>(sqes_);
+  auto* cqes = static_cast<io_uring_cqe*>(cqes_);
+  size_t next = 0;
+  while (next < reqs.size()) {
+    // one ring full per round, the completion queue is twice as big so it never overflows
+    unsigned n = static_cast<unsigned>(std::min<size_t>(entries_, reqs.size() - next));
+    unsigned tail = *sq_tail_;
+    for (unsigned i = 0; i < n; ++i) {
+      StatxRequest& r = reqs[next + i];
+      unsigned idx = (tail + i) & *sq_mask_;
+      io_uring_sqe& sqe = sqes[idx];
+      std::memset(&sqe, 0, sizeof(sqe));
+      sqe.opcode = IORING_OP_STATX;
+      sqe.fd = r.dir_fd;
+      sqe.addr = reinterpret_cast<uint64_t>(r.name);
+      sqe.len = mask;
+      sqe.off = reinterpret_cast<uint64_t>(r.out);
+      sqe.statx_flags = flags;
+      sqe.user_data = next + i;
+      sq_array_[idx] = idx;
+    }
+    // the kernel must see the entries before the new tail
+    __atomic_store_n(sq_tail_, tail + n, __ATOMIC_RELEASE);
+
+    unsigned done = 0;
+    unsigned submitted = 0;
+    while (done < n) {
+      int ret = io_uring_enter(fd_, n - submitted, n - done, IORING_ENTER_GETEVENTS);
+      if (ret < 0) {
+        if (errno == EINTR) continue;
+        drain(tail, n, done);
+        for (size_t i = next; i < reqs.size(); ++i) reqs[i].err = EIO;
+        return false;
+      }
+      submitted += std::min<unsigned>(ret, n - submitted);
+      unsigned head = *cq_head_;
+      unsigned ctail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      for (; head != ctail; ++head) {
+        const io_uring_cqe& cqe = cqes[head & *cq_mask_];
+        if (cqe.user_data - next < n) reqs[cqe.user_data].err = cqe.res < 0 ? -cqe.res : 0;
+        ++done;
+      }
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+    next += n;
+  }
+  return true;
+}
+
+}
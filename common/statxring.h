@@ -0,0 +1,67 @@
+#ifndef STATXRING_H_
+#define STATXRING_H_
+// Batched statx(2) over io_uring, without liburing.
+// A directory with thousands of candidates costs one io_uring_enter per ring full of statx
+// calls instead of one syscall each. create() returns null when the kernel (or a seccomp
+// policy) does not allow io_uring, callers then fall back to plain statx.
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace gutils {
+
+struct StatxRequest {
+  int dir_fd;
+  const char* name;     // relative to dir_fd, must stay valid until run() returns
+  struct statx* out;
+  int err;              // 0 or errno, set by run()
+};
+
+class StatxRing {
+public:
+  static std::unique_ptr<StatxRing> create(unsigned entries = 256);
+  ~StatxRing();
+  StatxRing(const StatxRing&) = delete;
+  StatxRing& operator=(const StatxRing&) = delete;
+
+  // stat every request (statx flags, e.g. AT_SYMLINK_NOFOLLOW), returns when all are done.
+  // false if the ring failed, the requests not done yet have err set to EIO. a failed ring is
+  // broken: what it had submitted is waited for before run() returns, later runs fail at once
+  bool run(std::vector<StatxRequest>& reqs, unsigned mask, int flags = AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC);
+
+  bool broken() const { return broken_; }
+
+private:
+  StatxRing() = default;
+
+  // after a failed io_uring_enter: takes back what the kernel has not picked up yet and waits
+  // for the rest, so no completion is left for the next run and no statx writes to a buffer
+  // the caller has freed
+  void drain(unsigned tail, unsigned n, unsigned done);
+
+  bool broken_ = false;
+  int fd_ = -1;
+  unsigned entries_ = 0;
+  // submission queue
+  void* sq_ptr_ = nullptr;
+  size_t sq_size_ = 0;
+  unsigned* sq_head_ = nullptr;
+  unsigned* sq_tail_ = nullptr;
+  unsigned* sq_mask_ = nullptr;
+  unsigned* sq_array_ = nullptr;
+  void* sqes_ = nullptr;
+  size_t sqes_size_ = 0;
+  // completion queue, shares the mapping with the submission queue when the kernel allows it
+  void* cq_ptr_ = nullptr;
+  size_t cq_size_ = 0;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned* cq_mask_ = nullptr;
+  void* cqes_ = nullptr;
+};
+
+}
+#endif // STATXRING_H_
@@ -0,0 +1,84 @@
+#include "visitedset.h"
+
+#include <sys/stat.h>
+
+#include <stdexcept>
+#include <thread>
+
+namespace gutils {
+
+namespace {
+uint64_t mix(uint64_t dev, uint64_t ino) {
+  // splitmix64 finalizer over both words, inode numbers are often sequential
+  uint64_t x = ino ^ (dev * 0x9E3779B97F4A7C15ull);
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+}
+
+VisitedSet::Table::Table(size_t n) : mask(n - 1), slots(new Slot[n]) {
+  for (size_t i = 0; i < n; ++i) {
+    slots[i].ino.store(0, std::memory_order_relaxed);
+    slots[i].dev.store(0, std::memory_order_relaxed);
+  }
+}
+
+VisitedSet::VisitedSet(size_t initial_slots) {
+  // a power of two, at least one probe window
+  size_t n = kProbe;
+  while (n < initial_slots) n <<= 1;
+  initial_slots_ = n;
+  for (auto& t : tables_) t.store(nullptr, std::memory_order_relaxed);
+  tables_[0].store(new Table(initial_slots_), std::memory_order_release);
+}
+
+VisitedSet::~VisitedSet() {
+  for (auto& t : tables_) delete t.load(std::memory_order_relaxed);
+}
+
+VisitedSet::Table* VisitedSet::table(int i) {
+  Table* t = tables_[i].load(std::memory_order_acquire);
+  if (t != nullptr) return t;
+  // several threads may get here at once, one allocation wins
+  auto fresh = std::make_unique<Table>(initial_slots_ << i);
+  if (tables_[i].compare_exchange_strong(t, fresh.get(), std::memory_order_acq_rel)) return fresh.release();
+  return t;
+}
+
+bool VisitedSet::insert(dev_t dev, ino_t ino) {
+  // 0 marks an empty slot. inode 0 does not occur on Linux filesystems, but keep it distinct anyway
+  const uint64_t key_ino = static_cast<uint64_t>(ino) + 1;
+  const uint64_t key_dev = static_cast<uint64_t>(dev) + 1;
+  const uint64_t h = mix(key_dev, key_ino);
+
+  for (int ti = 0; ti < kMaxTables; ++ti) {
+    Table* t = table(ti);
+    for (size_t p = 0; p < kProbe; ++p) {
+      Slot& s = t->slots[(h + p) & t->mask];
+      uint64_t cur = s.ino.load(std::memory_order_acquire);
+      if (cur == 0) {
+        if (s.ino.compare_exchange_strong(cur, key_ino, std::memory_order_acq_rel)) {
+          s.dev.store(key_dev, std::memory_order_release);
+          size_.fetch_add(1, std::memory_order_relaxed);
+          return true;
+        }
+        // lost the race, cur is now the key that won this slot
+      }
+      if (cur != key_ino) continue;
+      // same inode: the other half is written right after the claim
+      uint64_t d;
+      while ((d = s.dev.load(std::memory_order_acquire)) == 0) std::this_thread::yield();
+      if (d == key_dev) return false;
+    }
+  }
+  throw std::length_error("VisitedSet: too many directories");
+}
+
+bool VisitedSet::insert_fd(int fd) {
+  struct stat st;
+  if (::fstat(fd, &st) != 0) return false;
+  return insert(st.st_dev, st.st_ino);
+}
+
+}
@@ -0,0 +1,56 @@
+#ifndef VISITEDSET_H_
+#define VISITEDSET_H_
+// --follow: the directories a walk has already entered, keyed by (st_dev, st_ino).
+// A symlink farm reaches the same directory through many paths, and a link to an ancestor is a
+// cycle; insert() says whether a directory is new, so each one is read exactly once.
+//
+// Lock free, every directory goes through it. Open addressing with linear probing over a chain of
+// tables that double in size. Slots only ever go from empty to taken and every thread probes the
+// same sequence, so two threads inserting the same key always meet in the same slot. A key moves on
+// to the next table only when its whole probe window is taken by other keys, and since nothing is
+// ever removed it can then never show up in that window later.
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace gutils {
+
+class VisitedSet {
+public:
+  explicit VisitedSet(size_t initial_slots = 1 << 16);
+  ~VisitedSet();
+  VisitedSet(const VisitedSet&) = delete;
+  VisitedSet& operator=(const VisitedSet&) = delete;
+
+  // true if (dev, ino) was not in the set yet. thread safe
+  bool insert(dev_t dev, ino_t ino);
+  // insert() with the identity of an open directory, false (skip it) if it was seen already
+  // or fstat fails
+  bool insert_fd(int fd);
+
+  size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+private:
+  struct Slot {
+    std::atomic<uint64_t> ino;  // 0: empty. claimed with a CAS
+    std::atomic<uint64_t> dev;  // dev + 1, written right after the claim; 0 until then
+  };
+  struct Table {
+    explicit Table(size_t n);
+    size_t mask;
+    std::unique_ptr<Slot[]> slots;
+  };
+  static constexpr int kMaxTables = 32;
+  static constexpr size_t kProbe = 64;  // slots a key may look at in one table
+
+  Table* table(int i);
+
+  size_t initial_slots_;
+  std::atomic<Table*> tables_[kMaxTables];
+  std::atomic<size_t> size_{0};
+};
+
+}
+#endif // VISITEDSET_H_
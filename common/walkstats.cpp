@@ -0,0 +1,128 @@
+#include "walkstats.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+namespace gutils {
+
+namespace {
+std::atomic<uint64_t> g_next_registry_id{1};
+
+const char* const kPhaseNames[kPhaseCount] = {
+  "open", "readdir", "ignore", "match", "stat", "contents", "queue_wait", "output",
+};
+
+int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+uint64_t WalkStats::total(Phase p) const {
+  uint64_t t = exact[p];
+  if (sampled_iterations > 0) {
+    t += static_cast<uint64_t>(static_cast<double>(sampled[p]) * iterations / sampled_iterations);
+  }
+  return t;
+}
+
+void WalkStats::merge(const WalkStats& other) {
+  for (int p = 0; p < kPhaseCount; ++p) {
+    exact[p] += other.exact[p];
+    sampled[p] += other.sampled[p];
+  }
+  iterations += other.iterations;
+  sampled_iterations += other.sampled_iterations;
+  dirs += other.dirs;
+  entries += other.entries;
+  errors += other.errors;
+  matches += other.matches;
+}
+
+StatsRegistry::StatsRegistry()
+    : id_(g_next_registry_id.fetch_add(1)), start_ticks_(ticks()), start_ns_(now_ns()) {}
+
+WalkStats& StatsRegistry::local() {
+  // the id, not the address, identifies the registry: a new one may reuse the address of an old one
+  thread_local uint64_t cached_id = 0;
+  thread_local WalkStats* cached = nullptr;
+  if (cached_id != id_) {
+    auto stats = std::make_unique<WalkStats>();
+    cached = stats.get();
+    cached_id = id_;
+    std::lock_guard<std::mutex> lock(m_);
+    threads_.push_back(std::move(stats));
+  }
+  return *cached;
+}
+
+WalkStats StatsRegistry::merged() const {
+  WalkStats all;
+  std::lock_guard<std::mutex> lock(m_);
+  for (auto& s : threads_) all.merge(*s);
+  return all;
+}
+
+double StatsRegistry::ns_per_tick() const {
+  // the TSC rate, measured against steady_clock over the whole search
+  uint64_t t = ticks() - start_ticks_;
+  int64_t ns = now_ns() - start_ns_;
+  return t > 0 ? static_cast<double>(ns) / t : 1.0;
+}
+
+void StatsRegistry::set_peak_pending(uint64_t queued, uint64_t local) {
+  has_pending_ = true;
+  peak_queued_ = queued;
+  peak_local_ = local;
+}
+
+void StatsRegistry::report(std::ostream& out, bool json, double wall_ms) const {
+  WalkStats all = merged();
+  double scale = ns_per_tick() / 1e6;
+  size_t threads;
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    threads = threads_.size();
+  }
+  double phase_ms[kPhaseCount];
+  double busy_ms = 0;
+  for (int p = 0; p < kPhaseCount; ++p) {
+    phase_ms[p] = all.total(static_cast<Phase>(p)) * scale;
+    busy_ms += phase_ms[p];
+  }
+
+  char buf[160];
+  if (json) {
+    out << "{\"wall_ms\": " << wall_ms << ", \"threads\": " << threads
+        << ", \"dirs\": " << all.dirs << ", \"entries\": " << all.entries
+        << ", \"errors\": " << all.errors << ", \"matches\": " << all.matches
+        << ", \"sample_every\": " << WalkStats::kSampleEvery;
+    if (has_pending_) {
+      out << ", \"peak_pending\": {\"queued\": " << peak_queued_ << ", \"local\": " << peak_local_ << "}";
+    }
+    out << ", \"phases_ms\": {";
+    for (int p = 0; p < kPhaseCount; ++p) {
+      std::snprintf(buf, sizeof(buf), "%s\"%s\": %.3f", p ? ", " : "", kPhaseNames[p], phase_ms[p]);
+      out << buf;
+    }
+    out << "}}\n";
+    return;
+  }
+  std::snprintf(buf, sizeof(buf), "%.1f ms wall, %zu threads\n", wall_ms, threads);
+  out << buf;
+  out << all.dirs << " dirs, " << all.entries << " entries, " << all.errors << " errors, "
+      << all.matches << " matches\n";
+  if (has_pending_) {
+    out << "peak pending directories: " << peak_queued_ << " queued, " << peak_local_
+        << " on a worker's depth-first stack\n";
+  }
+  // thread time, so the phases add up to more than the wall time with several threads
+  for (int p = 0; p < kPhaseCount; ++p) {
+    std::snprintf(buf, sizeof(buf), "  %-10s %10.1f ms %5.1f%%\n", kPhaseNames[p], phase_ms[p],
+                  busy_ms > 0 ? 100.0 * phase_ms[p] / busy_ms : 0.0);
+    out << buf;
+  }
+}
+
+}
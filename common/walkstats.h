@@ -0,0 +1,122 @@
+#ifndef WALKSTATS_H_
+#define WALKSTATS_H_
+// --stats: where the time of a walk goes, per phase, and how much was walked.
+// Every thread counts into its own WalkStats, no atomics and no shared cache lines. They are
+// merged once the workers are joined. Time is read from the TSC where there is one.
+// Per directory work is timed every time. Per entry work (readdir, ignore and name matching,
+// output) costs about as much as reading the clock, so only every kSampleEvery-th entry is
+// timed and the phase total is extrapolated from that sample.
+// Disabled, all of this is one null pointer test per directory and per entry.
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace gutils {
+
+enum Phase {
+  kOpen,       // opening the directory, the --follow visited check
+  kReaddir,    // getdents64 and walking its buffer
+  kIgnore,     // loading .gitignore files and matching against them
+  kMatch,      // the name pattern
+  kStat,       // statx for the metadata filters
+  kContents,   // --contains reads, --dedupe hashing
+  kQueueWait,  // a worker waiting for a directory to work on
+  kOutput,     // handing results to the output buffers
+  kPhaseCount
+};
+
+inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct WalkStats {
+  static constexpr uint64_t kSampleEvery = 16;
+
+  uint64_t exact[kPhaseCount] = {};    // ticks, timed every time
+  uint64_t sampled[kPhaseCount] = {};  // ticks, timed for the sampled entries only
+  uint64_t iterations = 0;             // entry loop iterations, sampled or not
+  uint64_t sampled_iterations = 0;
+  uint64_t dirs = 0;
+  uint64_t entries = 0;
+  uint64_t errors = 0;
+  uint64_t matches = 0;
+
+  // true when this entry loop iteration is to be timed
+  bool sample_next() {
+    if (iterations++ % kSampleEvery != 0) return false;
+    ++sampled_iterations;
+    return true;
+  }
+
+  // ticks spent in a phase, sampled phases extrapolated to all iterations
+  uint64_t total(Phase p) const;
+  void merge(const WalkStats& other);
+};
+
+// adds the ticks between construction and stop() (or destruction) to a phase.
+// does nothing when stats is null
+class PhaseTimer {
+public:
+  PhaseTimer(WalkStats* stats, Phase phase, bool sampled = false)
+      : stats_(stats), phase_(phase), sampled_(sampled), start_(stats ? ticks() : 0) {}
+  ~PhaseTimer() { stop(); }
+  PhaseTimer(const PhaseTimer&) = delete;
+  PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+  void stop() {
+    if (!stats_) return;
+    (sampled_ ? stats_->sampled : stats_->exact)[phase_] += ticks() - start_;
+    stats_ = nullptr;
+  }
+
+private:
+  WalkStats* stats_;
+  Phase phase_;
+  bool sampled_;
+  uint64_t start_;
+};
+
+class StatsRegistry {
+public:
+  StatsRegistry();
+
+  // WalkStats of the calling thread, created on first use. Meant for pool threads that
+  // outlive a search, like OutputSink::local()
+  WalkStats& local();
+
+  // every thread's stats added up, only once those threads are done with them
+  WalkStats merged() const;
+
+  // peaks of the directories waiting to be walked, in the report once set (cpp_fd3)
+  void set_peak_pending(uint64_t queued, uint64_t local);
+
+  // a table, or one JSON object with json. wall_ms is the whole search
+  void report(std::ostream& out, bool json, double wall_ms) const;
+
+private:
+  double ns_per_tick() const;
+
+  uint64_t id_;
+  uint64_t start_ticks_;
+  int64_t start_ns_;
+  mutable std::mutex m_;
+  std::vector<std::unique_ptr<WalkStats>> threads_;
+  bool has_pending_ = false;
+  uint64_t peak_queued_ = 0;
+  uint64_t peak_local_ = 0;
+};
+
+}
+#endif // WALKSTATS_H_
@@ -1,6 +1,9 @@
 #include "zfs.h"
+#include "dirreader.h"
 #include <re2/re2.h>
+#include <sys/stat.h>
 #include <iostream>
+#include <memory>
 // Recursively search filename in directory
 // bool find_file(const fs::path &dir, const std::string &fname,
 //                fs::path &result, bool fuzzy ) {
@@ -28,27 +31,63 @@
 // }
 
 
-std::optional<fs::path> find_file(const fs::path &dir, const std::string &fname, bool fuzzy ) {
-  try {
-    for (auto const &entry : fs::recursive_directory_iterator(dir)) {
-      // std::cout << "searching " << fname << " in " << entry << '\n';
-      if(entry.is_regular_file()){
-        if (fuzzy) {
-          std::unique_ptr<RE2> pattern = std::make_unique<RE2>(fname);
-          if (RE2::PartialMatch(entry.path().filename().string(), *pattern)) {
-            return entry.path();
-          }
-        } else if (entry.path().filename().string().find(fname) !=
-                   std::string::npos) {
-          return entry.path();
-        }
+namespace {
+// depth first walk for find_file, pre-order like fs::recursive_directory_iterator.
+// readers[level] reads the directory at that depth: a child is opened with openat relative to its
+// parent's fd and gets its own buffer, so the parent can continue where it stopped.
+// dir_path is only used to build the returned path.
+std::optional<fs::path> find_file_at(std::vector<std::unique_ptr<gutils::DirReader>> &readers,
+                                     size_t level, std::string &dir_path,
+                                     const std::string &fname, const RE2 *pattern) {
+  gutils::DirReader &reader = *readers[level];
+  gutils::DirEntry entry;
+  while (reader.next(entry)) {
+    unsigned char type = reader.resolve_type(entry);
+    bool regular = type == DT_REG;
+    if (type == DT_LNK) {
+      // is_regular_file() follows symlinks, keep doing so for files
+      struct stat st;
+      regular = ::fstatat(reader.fd(), entry.name.data(), &st, 0) == 0 && S_ISREG(st.st_mode);
+    }
+    if (regular) {
+      bool found = pattern ? RE2::PartialMatch(entry.name, *pattern)
+                           : entry.name.find(fname) != std::string_view::npos;
+      if (found) {
+        return fs::path(dir_path) / entry.name;
       }
+    } else if (type == DT_DIR) {
+      if (readers.size() <= level + 1) {
+        readers.push_back(std::make_unique<gutils::DirReader>());
+      }
+      // an unreadable subdirectory is skipped, like the try/catch(...) this replaced
+      if (!readers[level + 1]->open_at(reader.fd(), entry.name.data())) continue;
+      size_t old_size = dir_path.size();
+      dir_path += '/';
+      dir_path += entry.name;
+      auto result = find_file_at(readers, level + 1, dir_path, fname, pattern);
+      dir_path.resize(old_size);
+      readers[level + 1]->close();
+      if (result) return result;
     }
-  } catch (...) {
-
   }
   return std::nullopt;
+}
+}
+
+std::optional<fs::path> find_file(const fs::path &dir, const std::string &fname, bool fuzzy ) {
+  // compile once for the whole walk instead of once per entry
+  std::unique_ptr<RE2> pattern;
+  if (fuzzy) {
+    pattern = std::make_unique<RE2>(fname);
+    if (!pattern->ok()) return std::nullopt;
+  }
+
+  std::vector<std::unique_ptr<gutils::DirReader>> readers;
+  readers.push_back(std::make_unique<gutils::DirReader>());
+  if (!readers[0]->open(dir.c_str())) return std::nullopt;
 
+  std::string dir_path = dir.string();
+  return find_file_at(readers, 0, dir_path, fname, pattern.get());
 }
 
 bool write_lines_to_file(const std::vector<std::string_view>& lines,
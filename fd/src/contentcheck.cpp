@@ -0,0 +1,63 @@
+/**
+ * Checks for ContentMatcher::file_matches around the cut between two pieces of a file:
+ * a match that straddles it is found, a $ or \b right before it is not taken for the end of
+ * the file. Exits 1 on the first wrong answer.
+ *
+ * cpp_contentcheck [dir]   (default: the temp directory)
+ */
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include "contentmatcher.h"
+
+namespace fs = std::filesystem;
+
+struct Case {
+    const char* pattern;
+    std::string before;  // ends exactly at the cut
+    std::string after;
+    bool expect;
+};
+
+int main(int argc, char* argv[]) {
+    fs::path dir = argc > 1 ? fs::path(argv[1]) : fs::temp_directory_path();
+    fs::path file = dir / ("cpp_contentcheck." + std::to_string(::getpid()));
+    const size_t cut = gutils::ContentMatcher::kChunk;
+    const std::string pad(cut - 64, 'x');
+
+    const Case cases[] = {
+        {"foo$", "foo", "bar\n", false},
+        {"foo\\b", "foo", "bar\n", false},
+        {"^$", "\n", "bar\n", false},
+        {"foobar$", "foo", "bar\n", true},
+        {"foo$", "foo", "\nbar\n", true},
+        {"foobar", "foo", "bar\n", true},
+        {"bar$", "foo", "bar", true},
+    };
+    int failed = 0;
+    for (const auto& c : cases) {
+        std::string head = pad + '\n';
+        head += std::string(cut - head.size() - c.before.size(), 'y') + c.before;
+        {
+            std::ofstream out(file, std::ios::binary | std::ios::trunc);
+            out << head << c.after;
+        }
+        gutils::ContentMatcher m(c.pattern);
+        int err = 0;
+        bool got = m.file_matches(file.c_str(), err);
+        if (got != c.expect || err != 0) {
+            std::cerr << "'" << c.pattern << "' at the cut: got " << got << ", expected " << c.expect;
+            if (err != 0) std::cerr << " (errno " << err << ")";
+            std::cerr << std::endl;
+            ++failed;
+        }
+    }
+    fs::remove(file);
+    if (failed == 0) std::cout << "ok" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -5,6 +5,7 @@
 #include <string>
 #include <fstream>
 #include <algorithm>
+#include "errorlog.h"
 
 namespace fs = std::filesystem;
 
@@ -68,34 +69,43 @@ void fd_search(
     const fs::path& dir,
     const std::regex& pattern,
     const std::vector<std::regex>& gitignore_rules,
+    gutils::ErrorLog& errors,
     int max_depth = -1,
     int current_depth = 0
 ) {
-    try {
-        for (const auto& entry : fs::directory_iterator(dir)) {
-            if (is_ignored(entry.path(), gitignore_rules)) {
-                continue;
-            }
+    // the error_code overloads, an unreadable directory is common and an exception for each one
+    // costs more than the rest of the walk
+    std::error_code ec;
+    fs::directory_iterator it(dir, ec);
+    if (ec) {
+        errors.add("Error accessing", dir.native(), ec.value());
+        return;
+    }
+    for (; it != fs::directory_iterator(); it.increment(ec)) {
+        const auto& entry = *it;
+        if (is_ignored(entry.path(), gitignore_rules)) {
+            continue;
+        }
 
-            // Check if the filename matches the pattern
-            std::string filename = entry.path().filename().string();
-            if (std::regex_search(filename, pattern)) {
-                std::cout << entry.path().string() << std::endl;
-            }
+        // Check if the filename matches the pattern
+        std::string filename = entry.path().filename().string();
+        if (std::regex_search(filename, pattern)) {
+            std::cout << entry.path().string() << std::endl;
+        }
 
-            // Recurse into subdirectories
-            if (entry.is_directory() && (max_depth == -1 || current_depth < max_depth)) {
-                fd_search(entry.path(), pattern, gitignore_rules, max_depth, current_depth + 1);
-            }
+        // Recurse into subdirectories
+        // a broken link or an entry gone meanwhile is just not a directory
+        std::error_code type_ec;
+        if (entry.is_directory(type_ec) && (max_depth == -1 || current_depth < max_depth)) {
+            fd_search(entry.path(), pattern, gitignore_rules, errors, max_depth, current_depth + 1);
         }
-    } catch (const fs::filesystem_error& e) {
-        std::cerr << "Error accessing " << dir << ": " << e.what() << std::endl;
     }
+    if (ec) errors.add("Error reading", dir.native(), ec.value());
 }
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <pattern> [directory] [--case-sensitive] [--max-depth N]\n";
+        std::cerr << "Usage: " << argv[0] << " <pattern> [directory] [--case-sensitive] [--max-depth N] [--quiet-errors]\n";
         return 1;
     }
 
@@ -109,6 +119,11 @@ int main(int argc, char* argv[]) {
     if (argc > 4 && std::string(argv[3]) == "--max-depth") {
         max_depth = std::stoi(argv[4]);
     }
+    // errors are still counted, but not listed
+    bool quiet_errors = false;
+    for (int i = 3; i < argc; ++i) {
+        if (std::string(argv[i]) == "--quiet-errors") quiet_errors = true;
+    }
 
     // Compile regex with case-insensitive flag if needed
     std::regex pattern;
@@ -125,7 +140,9 @@ int main(int argc, char* argv[]) {
     std::vector<std::regex> gitignore_rules = load_gitignore_rules(dir);
 
     // Perform search
-    fd_search(dir, pattern, gitignore_rules, max_depth);
+    gutils::ErrorLog errors(quiet_errors);
+    fd_search(dir, pattern, gitignore_rules, errors, max_depth);
+    errors.report(std::cerr);
 
     return 0;
 }
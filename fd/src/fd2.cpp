@@ -6,6 +6,8 @@
 #include <algorithm>
 #include <memory>
 #include <re2/re2.h>
+#include "namematcher.h"
+#include "errorlog.h"
 
 namespace fs = std::filesystem;
 using std::unique_ptr;
@@ -72,43 +74,52 @@ bool is_ignored(const fs::path& path, const std::vector<unique_ptr<RE2>>& rules)
 void fd_search(
     const fs::path& dir,
     // const std::regex& pattern,
-    const unique_ptr<RE2>& pattern,
+    const gutils::NameMatcher& pattern,
     const std::vector<unique_ptr<RE2>>& gitignore_rules,
+    gutils::ErrorLog& errors,
     int max_depth = -1,
     int current_depth = 0
 ) {
-    try {
-        for (const auto& entry : fs::directory_iterator(dir)) {
-            if (is_ignored(entry.path(), gitignore_rules)) {
-                continue;
-            }
-
-            // Check if the filename matches the pattern
-            std::string filename = entry.path().filename().string();
-            if (RE2::PartialMatch(filename, *pattern)) {
-              g_count +=1;
-                std::cout << entry.path().string() << std::endl;
-            }
-
-            // Recurse into subdirectories
-            if (entry.is_directory() && (max_depth == -1 || current_depth < max_depth)) {
-                fd_search(entry.path(), pattern, gitignore_rules, max_depth, current_depth + 1);
-            }
+    // the error_code overloads, an unreadable directory is common and an exception for each one
+    // costs more than the rest of the walk
+    std::error_code ec;
+    fs::directory_iterator it(dir, ec);
+    if (ec) {
+        errors.add("Error accessing", dir.native(), ec.value());
+        return;
+    }
+    for (; it != fs::directory_iterator(); it.increment(ec)) {
+        const auto& entry = *it;
+        if (is_ignored(entry.path(), gitignore_rules)) {
+            continue;
+        }
+
+        // Check if the filename matches the pattern
+        std::string filename = entry.path().filename().string();
+        if (pattern.matches(filename)) {
+          g_count +=1;
+            std::cout << entry.path().string() << std::endl;
+        }
+
+        // Recurse into subdirectories
+        // a broken link or an entry gone meanwhile is just not a directory
+        std::error_code type_ec;
+        if (entry.is_directory(type_ec) && (max_depth == -1 || current_depth < max_depth)) {
+            fd_search(entry.path(), pattern, gitignore_rules, errors, max_depth, current_depth + 1);
         }
-    } catch (const fs::filesystem_error& e) {
-        std::cerr << "Error accessing " << dir << ": " << e.what() << std::endl;
     }
+    if (ec) errors.add("Error reading", dir.native(), ec.value());
 }
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <pattern> [directory] [--case-sensitive] [--max-depth N]\n";
+        std::cerr << "Usage: " << argv[0] << " <pattern> [directory] [--case-sensitive] [--max-depth N] [--quiet-errors]\n";
         return 1;
     }
 
     // Parse arguments
     // std::string pattern_str = argv[1];
-    std::string pattern_str = glob_to_regex(argv[1]);
+    std::string pattern_str = argv[1];
     fs::path dir = (argc > 2) ? argv[2] : ".";
     bool case_sensitive = (argc > 3 && std::string(argv[3]) == "--case-sensitive");
     int max_depth = -1;
@@ -116,16 +127,20 @@ int main(int argc, char* argv[]) {
     if (argc > 4 && std::string(argv[3]) == "--max-depth") {
         max_depth = std::stoi(argv[4]);
     }
+    // errors are still counted, but not listed
+    bool quiet_errors = false;
+    for (int i = 3; i < argc; ++i) {
+        if (std::string(argv[i]) == "--quiet-errors") quiet_errors = true;
+    }
 
     // Compile regex with case-insensitive flag if needed
 
-    RE2::Options options;
     // if(case_sensitive)
     //   options.set_case_sensitive(case_sensitive);
-    options.set_case_sensitive(false);
-    auto pattern = make_unique<RE2>(pattern_str, options);
-    if(!pattern->ok()){
-      std::cerr << "Invalid regex pattern: " << pattern->error() << std::endl;
+    // *.log, RG-* and friends are compared directly, only real globs go through RE2
+    gutils::NameMatcher pattern(pattern_str, false);
+    if(!pattern.ok()){
+      std::cerr << "Invalid regex pattern: " << pattern.error() << std::endl;
       return 1;
     }
 
@@ -142,9 +157,10 @@ int main(int argc, char* argv[]) {
     std::vector<unique_ptr<RE2>> gitignore_rules = load_gitignore_rules(dir);
 
     // Perform search
-    fd_search(dir, pattern, gitignore_rules, max_depth);
+    gutils::ErrorLog errors(quiet_errors);
+    fd_search(dir, pattern, gitignore_rules, errors, max_depth);
+    errors.report(std::cerr);
 
-    // 5726
     std::cout << g_count << '\n';
     return 0;
 }
@@ -12,33 +12,40 @@
 #include <atomic>
 #include <regex>
 #include <chrono>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <optional>
 #include <re2/re2.h>
 #include "gutils.h"
+#include "dirreader.h"
+#include "gitignore.h"
+#include "namematcher.h"
+#include "outputsink.h"
+#include "orderedemitter.h"
+#include "execrunner.h"
+#include "patharena.h"
+#include "metafilter.h"
+#include "visitedset.h"
+#include "walkstats.h"
+#include "errorlog.h"
 
 namespace fs = std::filesystem;
 using std::unique_ptr;
 using std::make_unique;
 using std::cout;
 
-int g_count = 0;
-
-// Check if a path matches any .gitignore rule
-bool is_ignored(const fs::path& path, const std::vector<unique_ptr<RE2>>& rules) {
-    std::string_view path_view = path.string();
-    for (const auto& rule : rules) {
-        if (RE2::PartialMatch(path_view, *rule)) {
-            return true;
-        }
-    }
-    return false;
-}
+uint64_t g_count = 0;
 
 // Work item for directory processing
 struct WorkItem {
-    fs::path path;
+    gutils::PathArena::Id dir;  // the full path is rebuilt from the arena when the item is popped
     int depth;
+    gutils::IgnoreStack ignore;  // .gitignore rules in effect for the parent, shared not copied
+    gutils::OrderedEmitter::NodePtr sorted;  // --sorted only: where this directory's results go
 
-    WorkItem(const fs::path& p, int d) : path(p), depth(d) {}
+    WorkItem(gutils::PathArena::Id id, int d, gutils::IgnoreStack ig = nullptr, gutils::OrderedEmitter::NodePtr n = nullptr)
+        : dir(id), depth(d), ignore(std::move(ig)), sorted(std::move(n)) {}
 };
 
 // Thread-safe queue for directory paths
@@ -70,91 +77,370 @@ public:
         cv.notify_all();
     }
 
+    // worker index is unused, there is only one shared queue
+    void push(size_t, const WorkItem& item) { push(item); }
+    bool pop(size_t, WorkItem& item) { return pop(item); }
+
     bool empty()  {
         std::lock_guard<std::mutex> lock(m);
         return q.empty();
     }
 };
 
+// Work-stealing scheduler: one deque per worker.
+// The owner pushes and pops subdirectories at the back of its own deque (LIFO, cache friendly),
+// a worker whose deque is empty steals from the front of the others (oldest, usually biggest subtree).
+// Each deque has its own mutex, so in the common case a lock is only ever taken by its owner.
+class WorkStealingQueue {
+    struct alignas(64) Slot {  // one cache line per slot, avoid false sharing between owners
+        std::deque<WorkItem> q;
+        std::mutex m;
+    };
+    std::vector<unique_ptr<Slot>> slots;
+    std::atomic<bool> finished{false};
+
+    // idle workers sleep here; pushers only touch the mutex when somebody is actually idle
+    std::atomic<int> idle{0};
+    std::mutex idle_m;
+    std::condition_variable idle_cv;
+
+    bool try_pop_local(size_t self, WorkItem& item) {
+        Slot& s = *slots[self];
+        std::lock_guard<std::mutex> lock(s.m);
+        if (s.q.empty()) return false;
+        item = std::move(s.q.back());
+        s.q.pop_back();
+        return true;
+    }
+
+    bool try_steal(size_t self, WorkItem& item) {
+        for (size_t i = 1; i < slots.size(); ++i) {
+            Slot& victim = *slots[(self + i) % slots.size()];
+            std::unique_lock<std::mutex> lock(victim.m, std::try_to_lock);
+            if (!lock.owns_lock() || victim.q.empty()) continue;
+            item = std::move(victim.q.front());
+            victim.q.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+public:
+    explicit WorkStealingQueue(size_t num_workers) {
+        slots.reserve(num_workers);
+        for (size_t i = 0; i < num_workers; ++i) {
+            slots.push_back(make_unique<Slot>());
+        }
+    }
+
+    void push(size_t self, const WorkItem& item) {
+        {
+            Slot& s = *slots[self % slots.size()];
+            std::lock_guard<std::mutex> lock(s.m);
+            s.q.push_back(item);
+        }
+        if (idle.load(std::memory_order_acquire) > 0) {
+            std::lock_guard<std::mutex> lock(idle_m);
+            idle_cv.notify_one();
+        }
+    }
+
+    bool pop(size_t self, WorkItem& item) {
+        while (true) {
+            if (try_pop_local(self, item) || try_steal(self, item)) return true;
+            if (finished.load(std::memory_order_acquire)) return false;
+
+            // nothing to steal, sleep a little. the timeout covers a push racing with the idle check
+            std::unique_lock<std::mutex> lock(idle_m);
+            idle.fetch_add(1, std::memory_order_acq_rel);
+            idle_cv.wait_for(lock, std::chrono::milliseconds(1));
+            idle.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    void set_finished() {
+        finished.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(idle_m);
+        idle_cv.notify_all();
+    }
+
+    bool empty() {
+        for (auto& s : slots) {
+            std::lock_guard<std::mutex> lock(s->m);
+            if (!s->q.empty()) return false;
+        }
+        return true;
+    }
+};
+
+// --max-pending: how many directories may wait in the shared queue. a worker that would go
+// over keeps the subdirectory on its own stack and walks it depth first, so a wide tree no
+// longer grows the queue without bound. also counts the peaks for the stats, with or without a cap
+class PendingCap {
+public:
+    explicit PendingCap(int max_pending) : max_(max_pending) {}
+
+    // true: the item may go to the shared queue, false: the worker keeps it
+    bool try_reserve() {
+        int n = queued_.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (max_ > 0 && n > max_) {
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        raise(peak_queued_, n);
+        return true;
+    }
+    // an item left the shared queue
+    void popped() { queued_.fetch_sub(1, std::memory_order_relaxed); }
+    // a worker's deepest local stack, reported when it exits
+    void local_peak(int n) { raise(peak_local_, n); }
+
+    int peak_queued() const { return peak_queued_.load(); }
+    int peak_local() const { return peak_local_.load(); }
+
+private:
+    static void raise(std::atomic<int>& peak, int n) {
+        int cur = peak.load(std::memory_order_relaxed);
+        while (n > cur && !peak.compare_exchange_weak(cur, n, std::memory_order_relaxed)) {}
+    }
+
+    const int max_;  // 0: no cap
+    std::atomic<int> queued_{0};
+    std::atomic<int> peak_queued_{0};
+    std::atomic<int> peak_local_{0};
+};
+
+// Queue is DirQueue or WorkStealingQueue, self is the index of this worker
+template <typename Queue>
 void worker(
-    DirQueue& dq,
-    const unique_ptr<RE2>& pattern,
-    const std::vector<unique_ptr<RE2>>& gitignore_rules,
+    Queue& dq,
+    size_t self,
+    PendingCap& cap,
+    const gutils::NameMatcher& pattern,
+    const gutils::MetaFilter* meta,  // non null with --type, --size, --changed-within or --owner
+    bool io_uring,
+    gutils::VisitedSet* visited,  // --follow: directories entered so far
+    gutils::StatsRegistry* stats_registry,  // --stats, null without
+    gutils::PathArena& arena,
     int max_depth,
     std::atomic<int>& pending_work,
-    std::mutex& output_mtx,
+    gutils::OutputSink& sink,
+    gutils::OrderedEmitter* emitter,  // non null with --sorted
+    gutils::ErrorLog& errors,
     std::condition_variable& worker_cv,
     std::mutex& worker_mtx
 
 ) {
-    WorkItem item(fs::path{}, 0);
-
-    while (dq.pop(item)) {
-        try {
-            // Process current directory
-            for (const auto& entry : fs::directory_iterator(item.path)) {
-                if (is_ignored(entry.path(), gitignore_rules)) {
-                    continue;
-                }
-
-                // Check if filename matches pattern
-                std::string filename = entry.path().filename().string();
-                if (RE2::PartialMatch(filename, *pattern)) {
-                    std::lock_guard<std::mutex> lock(output_mtx);
-                    std::cout << entry.path().string() << std::endl;
-                    g_count +=1;
+    WorkItem item(gutils::PathArena::kRoot, 0);
+    gutils::WalkStats* ws = stats_registry ? &stats_registry->local() : nullptr;
+    // matches go to this worker's own buffer, no lock per match
+    gutils::OutputSink::Writer out(sink);
+    // one getdents buffer per worker, reused for every directory it reads
+    gutils::DirReader reader;
+    gutils::DirEntry entry;
+    // reused for every directory and entry, they stop allocating once they are big enough
+    std::string dir_path;
+    std::string entry_path;
+    // entries that passed the name and d_type checks but need a statx, stat'ed together per directory
+    std::unique_ptr<gutils::StatxRing> ring;
+    if (io_uring && meta && meta->needs_stat()) {
+        ring = gutils::StatxRing::create();
+        if (!ring && self == 0) {
+            std::cerr << "io_uring is not available, using plain statx" << std::endl;
+        }
+    }
+    std::optional<gutils::StatBatch> stats;
+    if (meta && meta->needs_stat()) stats.emplace(*meta, ring.get());
+    // subdirectories that did not fit in the shared queue, the back is walked next (depth first)
+    std::deque<WorkItem> local;
+    size_t local_peak = 0;
+    auto next_item = [&](WorkItem& next) {
+        // the queue has room again: the oldest local items, the biggest subtrees, go back to be shared
+        while (!local.empty() && cap.try_reserve()) {
+            dq.push(self, local.front());
+            local.pop_front();
+        }
+        if (!local.empty()) {
+            next = std::move(local.back());
+            local.pop_back();
+            return true;
+        }
+        gutils::PhaseTimer wait(ws, gutils::kQueueWait);
+        if (!dq.pop(self, next)) return false;
+        cap.popped();
+        return true;
+    };
+
+    while (next_item(item)) {
+        arena.path(item.dir, dir_path);
+        gutils::PhaseTimer open_timer(ws, gutils::kOpen);
+        if (ws) ++ws->dirs;
+        // Process current directory
+        if (!reader.open(dir_path.c_str())) {
+            if (ws) ++ws->errors;
+            errors.add("Error accessing", dir_path, reader.error());
+        }
+        // --follow: a directory reached a second time, through another link or a cycle, is not read again
+        if (reader.fd() >= 0 && visited && !visited->insert_fd(reader.fd())) {
+            reader.close();
+        }
+        open_timer.stop();
+        // this directory's .gitignore, if any, on top of the inherited rules
+        gutils::PhaseTimer ignore_timer(ws, gutils::kIgnore);
+        gutils::IgnoreStack ignore = reader.fd() >= 0
+            ? gutils::IgnoreNode::enter(reader.fd(), dir_path, item.ignore)
+            : item.ignore;
+        ignore_timer.stop();
+        while (true) {
+            // per entry work is timed for a sample of the entries only, sample is null for the rest
+            gutils::WalkStats* sample = ws && ws->sample_next() ? ws : nullptr;
+            gutils::PhaseTimer readdir_timer(sample, gutils::kReaddir, true);
+            if (!reader.next(entry)) break;
+            readdir_timer.stop();
+            if (ws) ++ws->entries;
+            entry_path.assign(dir_path);
+            if (!entry_path.empty() && entry_path.back() != '/') entry_path += '/';
+            entry_path.append(entry.name);
+            // d_type tells us without a stat in most cases.
+            // --follow: a link counts as what it points to, a link to a directory is walked
+            unsigned char type = visited ? reader.follow_type(entry) : reader.resolve_type(entry);
+            bool is_dir = type == DT_DIR;
+            gutils::PhaseTimer entry_ignore_timer(sample, gutils::kIgnore, true);
+            if (gutils::is_ignored(ignore, entry_path, is_dir)) {
+                continue;
+            }
+            entry_ignore_timer.stop();
+
+            // Check if filename matches pattern
+            gutils::PhaseTimer match_timer(sample, gutils::kMatch, true);
+            bool matched = pattern.matches(entry.name);
+            match_timer.stop();
+            if (matched && meta) {
+                matched = meta->type_ok(type);
+                if (matched && meta->needs_stat()) {
+                    if (!item.sorted) {
+                        stats->add(entry.name);
+                        matched = false;
+                    } else {
+                        // --sorted: the emitter needs the answer now
+                        gutils::PhaseTimer stat_timer(sample, gutils::kStat, true);
+                        int err = 0;
+                        matched = meta->stat_matches(reader.fd(), entry.name.data(), err);
+                        stat_timer.stop();
+                        if (err != 0) {
+                            if (ws) ++ws->errors;
+                            errors.add("Error accessing", entry_path, err);
+                        }
+                    }
                 }
-
-                // Add subdirectories to queue
-                if (entry.is_directory() && (max_depth == -1 || item.depth < max_depth)) {
-                    pending_work.fetch_add(1);
-                    dq.push(WorkItem(entry.path(), item.depth + 1));
+            }
+            bool descend = is_dir && (max_depth == -1 || item.depth < max_depth);
+
+            gutils::OrderedEmitter::NodePtr child;
+            gutils::PhaseTimer output_timer(sample, gutils::kOutput, true);
+            if (matched && ws) ++ws->matches;
+            if (item.sorted) {
+                // kept with the directory until it can be written in order
+                child = item.sorted->add(entry.name, matched, descend);
+            } else if (matched) {
+                out.add(entry_path);
+            }
+            output_timer.stop();
+
+            // Add subdirectories to queue
+            if (descend) {
+                pending_work.fetch_add(1);
+                WorkItem sub(arena.add(item.dir, entry.name), item.depth + 1, ignore, std::move(child));
+                if (cap.try_reserve()) {
+                    dq.push(self, sub);
+                } else {
+                    local.push_back(std::move(sub));
+                    local_peak = std::max(local_peak, local.size());
                 }
             }
-        } catch (const fs::filesystem_error& e) {
-            std::lock_guard<std::mutex> lock(output_mtx);
-            std::cerr << "Error accessing " << item.path << ": " << e.what() << std::endl;
         }
+        if (reader.error() != 0 && reader.fd() >= 0) {
+            if (ws) ++ws->errors;
+            errors.add("Error reading", dir_path, reader.error());
+        }
+        if (stats && !stats->empty()) {
+            gutils::PhaseTimer stat_timer(ws, gutils::kStat);
+            stats->run(reader.fd(),
+                [&](std::string_view name, const struct statx&) {
+                    if (ws) ++ws->matches;
+                    out.add(dir_path, name);
+                },
+                [&](std::string_view name, int err) {
+                    if (ws) ++ws->errors;
+                    entry_path.assign(dir_path).append("/").append(name);
+                    errors.add("Error accessing", entry_path, err);
+                });
+        }
+        reader.close();
+        if (item.sorted) {
+            emitter->complete(item.sorted);
+            item.sorted.reset();
+        }
+        out.flush_if_stale();
 
         // Mark this work item as complete
-        pending_work.fetch_sub(1);
-
-        {
+        // only the worker that brings pending_work to 0 wakes up the main thread,
+        // taking worker_mtx for every directory would be another global lock
+        if (pending_work.fetch_sub(1) == 1) {
           // this extra braces is toLimit the Scope of the Lock
           std::lock_guard<std::mutex> lock(worker_mtx);
           worker_cv.notify_all();
         }
     }
+    cap.local_peak(static_cast<int>(local_peak));
 }
 
+template <typename Queue>
 void fd_search_enhanced(
+    Queue& dir_queue,
+    PendingCap& cap,
     const fs::path& start_dir,
-    const unique_ptr<RE2>& pattern,
-    const std::vector<unique_ptr<RE2>>& gitignore_rules,
+    const gutils::NameMatcher& pattern,
+    const gutils::MetaFilter* meta,
+    bool io_uring,
+    gutils::VisitedSet* visited,
+    gutils::StatsRegistry* stats_registry,
+    gutils::ErrorLog& errors,
+    gutils::OutputSink& sink,
+    gutils::OrderedEmitter* emitter,
     int max_depth = -1,
     int num_threads = std::thread::hardware_concurrency()
 ) {
-    DirQueue dir_queue;
     std::atomic<int> pending_work{1};  // Start with 1 for the initial directory
-    std::mutex output_mtx;
     std::mutex worker_mtx;
     std::condition_variable worker_cv;
+    // every directory the walk queues, lives until the workers are joined
+    gutils::PathArena arena(start_dir.native());
 
-    // Add initial directory to queue
-    dir_queue.push(WorkItem(start_dir, 0));
+    // Add initial directory to queue, a cap is at least 1 so it always fits
+    cap.try_reserve();
+    dir_queue.push(0, WorkItem(gutils::PathArena::kRoot, 0, nullptr, emitter ? emitter->root(start_dir.native()) : nullptr));
 
     // Create worker threads
     std::vector<std::thread> workers;
     workers.reserve(num_threads);
 
     for (int i = 0; i < num_threads; ++i) {
-        workers.emplace_back(worker,
+        workers.emplace_back(worker<Queue>,
             std::ref(dir_queue),
+            static_cast<size_t>(i),
+            std::ref(cap),
             std::ref(pattern),
-            std::ref(gitignore_rules),
+            meta,
+            io_uring,
+            visited,
+            stats_registry,
+            std::ref(arena),
             max_depth,
             std::ref(pending_work),
-            std::ref(output_mtx),
+            std::ref(sink),
+            emitter,
+            std::ref(errors),
             std::ref(worker_cv),
             std::ref(worker_mtx)
         );
@@ -185,16 +471,33 @@ void fd_search_enhanced(
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <pattern> [directory] [--case-sensitive] [--max-depth N] [--threads N]\n";
+        std::cerr << "Usage: " << argv[0] << " <pattern> [directory] [--case-sensitive] [--max-depth N] [--threads N] [--scheduler steal|queue] [--sorted] [--type f|d|l|p|s|x] [--size [+-]N[unit]] [--changed-within N[unit]] [--owner USER[:GROUP]] [--io-uring] [--follow] [--max-pending N] [--stats [json]] [--quiet-errors] [-x|-X CMD... [;]]\n";
         return 1;
     }
 
     // Parse arguments
-    std::string pattern_str = gutils::glob_to_regex(argv[1]);
+    std::string pattern_str = argv[1];
     fs::path dir = (argc > 2) ? argv[2] : ".";
     bool case_sensitive = false;
     int max_depth = -1;
     int num_threads = std::thread::hardware_concurrency();
+    // steal: per-worker deques with work stealing, queue: the single locked DirQueue
+    std::string scheduler = "steal";
+    bool sorted = false;
+    // -x: one process per result, -X: as many results per process as fit
+    std::vector<std::string> exec_cmd;
+    bool exec_batch = false;
+    gutils::MetaFilter meta;
+    bool io_uring = false;
+    bool follow = false;
+    // directories waiting in the queue, 0 is no limit
+    int max_pending = 0;
+    // --stats: per phase timings on stderr at the end, --stats json for one JSON object
+    bool show_stats = false;
+    bool stats_json = false;
+    // errors are still counted, but not listed
+    bool quiet_errors = false;
+    std::string meta_error;
 
     // Parse command line arguments
     for (int i = 3; i < argc; ++i) {
@@ -205,32 +508,105 @@ int main(int argc, char* argv[]) {
             max_depth = std::stoi(argv[++i]);
         } else if (arg == "--threads" && i + 1 < argc) {
             num_threads = std::stoi(argv[++i]);
+        } else if (arg == "--scheduler" && i + 1 < argc) {
+            scheduler = argv[++i];
+        } else if (arg == "--sorted") {
+            sorted = true;
+        } else if (arg == "--type" && i + 1 < argc) {
+            if (!meta.add_type(argv[++i], meta_error)) break;
+        } else if (arg == "--size" && i + 1 < argc) {
+            if (!meta.add_size(argv[++i], meta_error)) break;
+        } else if (arg == "--changed-within" && i + 1 < argc) {
+            if (!meta.set_changed_within(argv[++i], meta_error)) break;
+        } else if (arg == "--owner" && i + 1 < argc) {
+            if (!meta.set_owner(argv[++i], meta_error)) break;
+        } else if (arg == "--io-uring") {
+            io_uring = true;
+        } else if (arg == "--follow") {
+            follow = true;
+        } else if (arg == "--stats") {
+            show_stats = true;
+            if (i + 1 < argc && std::string(argv[i + 1]) == "json") {
+                stats_json = true;
+                ++i;
+            }
+        } else if (arg == "--quiet-errors") {
+            quiet_errors = true;
+        } else if (arg == "--max-pending" && i + 1 < argc) {
+            max_pending = std::stoi(argv[++i]);
+            if (max_pending < 1) {
+                std::cerr << "--max-pending must be at least 1" << std::endl;
+                return 1;
+            }
+        } else if ((arg == "-x" || arg == "-X") && i + 1 < argc) {
+            exec_batch = arg == "-X";
+            // the command takes the rest of the line, up to an optional ";"
+            while (++i < argc && std::string(argv[i]) != ";") exec_cmd.push_back(argv[i]);
         }
     }
+    if (!meta_error.empty()) {
+        std::cerr << "Invalid filter: " << meta_error << std::endl;
+        return 1;
+    }
+    if (num_threads < 1) num_threads = 1;
+    meta.set_follow(follow);
+    std::unique_ptr<gutils::VisitedSet> visited;
+    if (follow) visited = make_unique<gutils::VisitedSet>();
+    if (scheduler != "steal" && scheduler != "queue") {
+        std::cerr << "Unknown scheduler: " << scheduler << " (expected steal or queue)\n";
+        return 1;
+    }
 
-    // Compile regex
-    RE2::Options options;
-    options.set_case_sensitive(case_sensitive);
-
-    auto pattern = make_unique<RE2>(pattern_str, options);
-    if(!pattern->ok()){
-      std::cerr << "Invalid regex pattern: " << pattern->error() << std::endl;
+    // literal shapes like *.log are matched without RE2, the rest is compiled to a regex
+    gutils::NameMatcher pattern(pattern_str, case_sensitive);
+    if(!pattern.ok()){
+      std::cerr << "Invalid regex pattern: " << pattern.error() << std::endl;
       return 1;
     }
 
-    // Load .gitignore rules
-    std::vector<unique_ptr<RE2>> gitignore_rules = gutils::load_gitignore_rules(dir);
+    // .gitignore files are loaded by the workers as they enter each directory
 
     // Perform search with timing
     auto start_time = std::chrono::high_resolution_clock::now();
-
-    fd_search_enhanced(dir, pattern, gitignore_rules, max_depth, num_threads);
+    // results are written while the walk runs, by one writer thread in large chunks
+    // with -x/-X the results go to the commands instead of stdout, they start while the walk goes on.
+    // --threads also limits how many commands run at once
+    std::unique_ptr<gutils::ExecRunner> exec;
+    if (!exec_cmd.empty()) exec = make_unique<gutils::ExecRunner>(exec_cmd, exec_batch, num_threads);
+    auto sink_ptr = exec
+        ? make_unique<gutils::OutputSink>([&exec](std::string_view chunk) { exec->feed(chunk); })
+        : make_unique<gutils::OutputSink>();
+    gutils::OutputSink& sink = *sink_ptr;
+    std::unique_ptr<gutils::OrderedEmitter> emitter;
+    if (sorted) emitter = make_unique<gutils::OrderedEmitter>(sink);
+
+    PendingCap cap(max_pending);
+    std::unique_ptr<gutils::StatsRegistry> stats_registry;
+    if (show_stats) stats_registry = make_unique<gutils::StatsRegistry>();
+    // the workers only note errors, they are listed once the walk is done
+    gutils::ErrorLog errors(quiet_errors);
+    if (scheduler == "queue") {
+        DirQueue dir_queue;
+        fd_search_enhanced(dir_queue, cap, dir, pattern, meta.active() ? &meta : nullptr, io_uring, visited.get(), stats_registry.get(), errors, sink, emitter.get(), max_depth, num_threads);
+    } else {
+        WorkStealingQueue dir_queue(num_threads);
+        fd_search_enhanced(dir_queue, cap, dir, pattern, meta.active() ? &meta : nullptr, io_uring, visited.get(), stats_registry.get(), errors, sink, emitter.get(), max_depth, num_threads);
+    }
+    if (emitter) emitter->finish();
+    sink.close();
+    g_count = sink.lines();
+    int status = exec ? exec->finish() : 0;
+    errors.report(std::cerr);
 
     auto end_time = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
 
-    std::cerr << "Search completed in " << duration.count() << " ms using " << num_threads << " threads" << std::endl;
+    std::cerr << "Search completed in " << duration.count() << " ms using " << num_threads << " threads (" << scheduler << " scheduler)" << std::endl;
+    if (stats_registry) {
+        stats_registry->set_peak_pending(cap.peak_queued(), cap.peak_local());
+        stats_registry->report(std::cerr, stats_json, duration.count());
+    }
 
     std::cout << g_count << '\n';
-    return 0;
+    return status;
 }
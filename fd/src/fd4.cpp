@@ -55,10 +55,35 @@ or put initial state to be 1
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <cstring>
+#include <cctype>
+#include <iomanip>
+#include <optional>
+#include <csignal>
 #include <re2/re2.h>
+#include <sys/sysmacros.h>
 
 #include "net/threadpool.h"
 #include "gutils.h"
+#include "dirreader.h"
+#include "gitignore.h"
+#include "namematcher.h"
+#include "multimatcher.h"
+#include "outputsink.h"
+#include "orderedemitter.h"
+#include "execrunner.h"
+#include "patharena.h"
+#include "metafilter.h"
+#include "resultlimit.h"
+#include "visitedset.h"
+#include "devinfo.h"
+#include "walkstats.h"
+#include "contentmatcher.h"
+#include "dupfinder.h"
+#include "diskusage.h"
+#include "dirwatcher.h"
+#include "errorlog.h"
+#include "fdindex.h"
 #include "tool.h"
 
 namespace fs = std::filesystem;
@@ -66,116 +91,835 @@ using std::unique_ptr;
 using std::make_unique;
 using std::cout;
 
-int g_count = 0;
-std::mutex coutmtx;
+uint64_t g_count = 0;
 
-// Check if a path matches any .gitignore rule
-bool is_ignored(const fs::path& path, const std::vector<unique_ptr<RE2>>& rules) {
-    std::string_view path_view = path.string();
-    for (const auto& rule : rules) {
-        if (RE2::PartialMatch(path_view, *rule)) {
-            return true;
+// a result given as its path, with -e followed by the tags of the patterns its name matches.
+// for results that did not keep their pattern ids, the name is matched again
+void add_result(gutils::OutputSink::Writer& out, std::string_view path, const gutils::MultiMatcher* multi) {
+    if (!multi) {
+        out.add(path);
+        return;
+    }
+    size_t name_at = path.rfind('/');
+    name_at = name_at == std::string_view::npos ? 0 : name_at + 1;
+    thread_local std::string tags;
+    multi->tags_of(path.substr(name_at), tags);
+    out.add(path.substr(0, name_at), path.substr(name_at), tags);
+}
+
+// --contains: check the contents of name matched files, print the ones that match
+void fd_search_contents(
+    const std::vector<std::string>& files,
+    const gutils::ContentMatcher& contains,
+    gutils::ResultLimit& limit,
+    gutils::OutputSink& sink,
+    const gutils::MultiMatcher* multi,  // -e, null without
+    gutils::ErrorLog& errors,
+    gutils::WalkStats* ws  // --stats, null without
+) {
+    gutils::PhaseTimer contents_timer(ws, gutils::kContents);
+    int err = 0;
+    for (const auto& file : files) {
+        if (limit.cancelled()) return;
+        if (contains.file_matches(file.c_str(), err)) {
+            if (limit.take()) {
+                if (ws) ++ws->matches;
+                add_result(sink.local(), file, multi);
+            }
+        } else if (err != 0) {
+            if (ws) ++ws->errors;
+            errors.add("Error reading", file, err);
         }
     }
-    return false;
 }
 
-// Thread-safe result collector
-class ResultCollector {
-private:
-    std::vector<std::string> results;
-    std::mutex mutex;
+// What an entry has to pass to be printed, checked in this order: the cheap ones first
+struct Filters {
+    const gutils::NameMatcher& pattern;
+    const gutils::MetaFilter* meta = nullptr;          // --type, --size, --changed-within, --owner
+    bool io_uring = false;                             // --io-uring: a directory's statx calls in one batch
+    const gutils::ContentMatcher* contains = nullptr;  // --contains
+    gutils::ResultLimit* limit = nullptr;              // --max-results, also counts with no limit set
+    gutils::VisitedSet* visited = nullptr;             // --follow: directories entered so far
+    bool hdd = false;                                  // --hdd: a directory's entries are handled in inode order
+    gutils::StatsRegistry* stats = nullptr;            // --stats, not a filter but goes everywhere the filters go
+    const gutils::MultiMatcher* multi = nullptr;       // -e: all the patterns instead of pattern, the output is tagged
+    gutils::DuplicateFinder* dedupe = nullptr;         // --dedupe: the regular files go here, not to the output
+    gutils::DiskUsage* du = nullptr;                   // --du: the blocks of the matched files are added up
+    bool du_extensions = false;                        // --by-ext
+    gutils::DirWatcher* watcher = nullptr;             // --watch: every directory the walk enters is watched
+    gutils::ErrorLog* errors = nullptr;                // always set, listed once the walk is done
 
-public:
-    void add_result(const std::string& path) {
-        std::lock_guard<std::mutex> lock(mutex);
-        results.push_back(path);
+    // the name pattern, or with -e every pattern: ids gets the ones that matched
+    bool name_matches(std::string_view name, std::vector<int>& ids) const {
+        return multi ? multi->match(name, ids) : pattern.matches(name);
     }
+};
 
-    void print_results() {
-        std::lock_guard<std::mutex> lock(mutex);
-        for (const auto& result : results) {
-          g_count +=1;
-            std::cout << result << std::endl;
+// --hdd: the whole directory is read first and its entries sorted by inode number, which is
+// about the order they are laid out on disk. the stats, the content reads and the subdirectories
+// queued after them then move the head forward instead of back and forth
+class InodeOrder {
+public:
+    void read(gutils::DirReader& reader) {
+        entries_.clear();
+        names_.clear();
+        std::vector<size_t> offsets;
+        gutils::DirEntry entry;
+        while (reader.next(entry)) {
+            offsets.push_back(names_.size());
+            // NUL terminated like in the getdents buffer, resolve_type passes the name to fstatat
+            names_.append(entry.name.data(), entry.name.size());
+            names_ += '\0';
+            entries_.push_back(entry);
         }
+        // the views point into names_ only once it stopped growing
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            entries_[i].name = std::string_view(names_.data() + offsets[i], entries_[i].name.size());
+        }
+        std::sort(entries_.begin(), entries_.end(),
+                  [](const gutils::DirEntry& a, const gutils::DirEntry& b) { return a.ino < b.ino; });
+        next_ = 0;
+    }
+
+    bool next(gutils::DirEntry& entry) {
+        if (next_ == entries_.size()) return false;
+        entry = entries_[next_++];
+        return true;
     }
+
+private:
+    std::vector<gutils::DirEntry> entries_;
+    std::string names_;
+    size_t next_ = 0;
 };
 
+// --max-results reached: drop the queued tasks instead of running them. they were counted in
+// active_tasks when they were queued
+void cancel_pending(ThreadPool& pool, std::atomic<int>& active_tasks) {
+    size_t dropped = pool.clear();
+    if (dropped > 0) active_tasks.fetch_sub(static_cast<int>(dropped), std::memory_order_release);
+}
+
+// this thread's statx ring, null when --io-uring is off or the kernel does not allow it
+gutils::StatxRing* thread_ring(const Filters& filters) {
+    thread_local std::unique_ptr<gutils::StatxRing> ring;
+    thread_local bool tried = false;
+    // a ring that failed once has waited out what it had in flight, plain statx from here on
+    if (ring && ring->broken()) ring.reset();
+    if (!filters.io_uring || tried) return ring.get();
+    tried = true;
+    ring = gutils::StatxRing::create();
+    static std::once_flag warned;
+    if (!ring) {
+        std::call_once(warned, [] { std::cerr << "io_uring is not available, using plain statx" << std::endl; });
+    }
+    return ring.get();
+}
+
+// --stats: the pool does not say how long a thread waited for a task. the time since this
+// thread finished its previous task is the closest thing
+thread_local uint64_t t_last_task_end = 0;
+
 // Alternative implementation using thread pool for better resource management
 void fd_search_threaded(
-    const fs::path& dir,
-    const unique_ptr<RE2>& pattern,
-    const std::vector<unique_ptr<RE2>>& gitignore_rules,
-    ResultCollector& collector,
+    gutils::PathArena::Id dir,
+    gutils::PathArena& arena,
+    const Filters& filters,
+    const gutils::IgnoreStack& parent_ignore,
+    gutils::OutputSink& sink,
+    gutils::OrderedEmitter* emitter,        // non null with --sorted
+    const gutils::OrderedEmitter::NodePtr& node,  // --sorted: where this directory's results go
     ThreadPool& pool,
     std::atomic<int>& active_tasks,
-    std::mutex& output_mtx,
     int max_depth = -1,
     int current_depth = 0
 ) {
     // active_tasks++;
   // active_tasks.fetch_add(1, std::memory_order_relaxed);
   // active_tasks.store(1);
-    try {
-        std::vector<fs::path> subdirs;
-        // print("dir:", dir);
-        // Process current directory
-        for (const auto& entry : fs::directory_iterator(dir)) {
-            if (is_ignored(entry.path(), gitignore_rules)) {
-                continue;
-            }
-            // print(entry.path().string());
+    gutils::WalkStats* ws = filters.stats ? &filters.stats->local() : nullptr;
+    if (ws && t_last_task_end != 0) ws->exact[gutils::kQueueWait] += gutils::ticks() - t_last_task_end;
+    if (filters.limit->cancelled()) {
+        // queued before the limit was hit, or between another task's cancel_pending and now
+        cancel_pending(pool, active_tasks);
+        if (ws) t_last_task_end = gutils::ticks();
+        active_tasks.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+    // every pool thread keeps its own getdents buffer, a task never reads two directories at once
+    thread_local gutils::DirReader reader;
+    gutils::DirEntry entry;
+    // the queued directory is only an arena id, its path is rebuilt here into a reused buffer
+    thread_local std::string dir_path;
+    thread_local std::string entry_path;
+    // -e: the patterns an entry matched, and their tags once it is a result
+    thread_local std::vector<int> ids;
+    thread_local std::string tags;
+    arena.path(dir, dir_path);
+
+    std::vector<std::pair<gutils::PathArena::Id, gutils::OrderedEmitter::NodePtr>> subdirs;
+    std::vector<std::string> files;  // --contains: name matches whose content is still to check
+    // entries that passed the name and d_type checks but need a statx, stat'ed together at the end
+    std::optional<gutils::StatBatch> stats;
+    if (filters.meta && filters.meta->needs_stat() && !node) stats.emplace(*filters.meta, thread_ring(filters));
+    // print("dir:", dir);
+    gutils::PhaseTimer open_timer(ws, gutils::kOpen);
+    if (ws) ++ws->dirs;
+    // Process current directory
+    if (!reader.open(dir_path.c_str())) {
+        if (ws) ++ws->errors;
+        filters.errors->add("Error accessing", dir_path, reader.error());
+    }
+    // --follow: a directory reached a second time, through another link or a cycle, is not read again
+    if (reader.fd() >= 0 && filters.visited && !filters.visited->insert_fd(reader.fd())) {
+        reader.close();
+    }
+    open_timer.stop();
+    // --du: the directory's own blocks and those of its files, published when it is done
+    uint64_t du_bytes = 0;
+    uint64_t du_files = 0;
+    struct stat dir_st;
+    if (filters.du && reader.fd() >= 0 && ::fstat(reader.fd(), &dir_st) == 0) {
+        du_bytes = static_cast<uint64_t>(dir_st.st_blocks) * 512;
+    }
+    // this directory's .gitignore, if any, on top of the inherited rules.
+    // --du counts everything like du does: build/ and node_modules/ are often the biggest part
+    gutils::PhaseTimer ignore_timer(ws, gutils::kIgnore);
+    gutils::IgnoreStack ignore = reader.fd() >= 0 && !filters.du
+        ? gutils::IgnoreNode::enter(reader.fd(), dir_path, parent_ignore)
+        : parent_ignore;
+    ignore_timer.stop();
+    // --watch: watched before it is read, whatever changes from here on is an event.
+    // the results are noted in it, the events are compared against them
+    gutils::DirWatcher::Dir* watched = filters.watcher && reader.fd() >= 0
+        ? filters.watcher->add(dir_path, ignore, current_depth, reader.fd())
+        : nullptr;
+    thread_local InodeOrder by_inode;
+    if (filters.hdd) {
+        gutils::PhaseTimer readdir_timer(ws, gutils::kReaddir);
+        by_inode.read(reader);
+    }
+    while (!filters.limit->cancelled()) {
+        // per entry work is timed for a sample of the entries only, sample is null for the rest
+        gutils::WalkStats* sample = ws && ws->sample_next() ? ws : nullptr;
+        gutils::PhaseTimer readdir_timer(sample, gutils::kReaddir, true);
+        if (!(filters.hdd ? by_inode.next(entry) : reader.next(entry))) break;
+        readdir_timer.stop();
+        if (ws) ++ws->entries;
+        entry_path.assign(dir_path);
+        if (!entry_path.empty() && entry_path.back() != '/') entry_path += '/';
+        entry_path.append(entry.name);
+        // --follow: a link counts as what it points to, a link to a directory is walked
+        unsigned char type = filters.visited ? reader.follow_type(entry) : reader.resolve_type(entry);
+        bool is_dir = type == DT_DIR;
+        gutils::PhaseTimer entry_ignore_timer(sample, gutils::kIgnore, true);
+        if (gutils::is_ignored(ignore, entry_path, is_dir)) {
+            continue;
+        }
+        entry_ignore_timer.stop();
+        // print(entry_path.string());
 
-            std::string filename = entry.path().filename().string();
-            if (RE2::PartialMatch(filename, *pattern)) {
-              std::lock_guard<std::mutex> lock(output_mtx);
-                collector.add_result(entry.path().string());
+        gutils::PhaseTimer match_timer(sample, gutils::kMatch, true);
+        bool matched = filters.name_matches(entry.name, ids);
+        match_timer.stop();
+        // --du: a subdirectory counts in its own finish(), not as a file of this one
+        if (filters.du && is_dir) matched = false;
+        if (matched && filters.meta) {
+            matched = filters.meta->type_ok(type);
+            if (matched && stats) {
+                stats->add(entry.name);
+                matched = false;
+            } else if (matched && filters.meta->needs_stat()) {
+                // --sorted: the emitter needs the answer now
+                gutils::PhaseTimer stat_timer(sample, gutils::kStat, true);
+                int err = 0;
+                matched = filters.meta->stat_matches(reader.fd(), entry.name.data(), err);
+                stat_timer.stop();
+                if (err != 0) {
+                    if (ws) ++ws->errors;
+                    filters.errors->add("Error accessing", entry_path, err);
+                }
+            }
+        }
+        if (matched && filters.contains) {
+            // only regular files have content to search, symlinks are not followed
+            matched = type == DT_REG;
+            if (matched && !node) {
+                files.push_back(entry_path);
+                matched = false;
+            } else if (matched) {
+                // the emitter needs the answer now, so sorted output checks the file right here
+                gutils::PhaseTimer contents_timer(sample, gutils::kContents, true);
+                int err = 0;
+                matched = filters.contains->file_matches(entry_path.c_str(), err);
+                contents_timer.stop();
+                if (err != 0) {
+                    if (ws) ++ws->errors;
+                    filters.errors->add("Error reading", entry_path, err);
+                }
             }
+        }
+        bool descend = is_dir && (max_depth == -1 || current_depth < max_depth);
 
-            // Collect subdirectories for parallel processing
-            if (entry.is_directory() && (max_depth == -1 || current_depth < max_depth)) {
-                subdirs.push_back(entry.path());
+        gutils::OrderedEmitter::NodePtr child;
+        gutils::PhaseTimer output_timer(sample, gutils::kOutput, true);
+        tags.clear();
+        if (matched && filters.multi) filters.multi->tags(ids, tags);
+        if (node) {
+            // kept with the directory until it can be written in order
+            child = node->add(entry.name, matched, descend, tags);
+            if (matched && ws) ++ws->matches;
+        } else if (matched) {
+            // this pool thread's buffer, written out while the walk goes on
+            if (filters.limit->take()) {
+                if (ws) ++ws->matches;
+                sink.local().add(dir_path, entry.name, tags);
             }
         }
+        if (matched && watched) watched->matches.emplace(entry.name);
+        output_timer.stop();
 
-        // Enqueue subdirectories for parallel processing
-        for (const auto& subdir : subdirs) {
-          // Whenever you launch work (e.g., a thread, task, closure) inside a loop, and the work needs the current item, capture it by value in the closure.
-          // subdir is captured by value to ensure each thread have their own copy of var
-          // print("push ---------subdir:", subdir.string());
-          active_tasks.fetch_add(1, std::memory_order_relaxed);
-          pool.enqueue(fd_search_threaded, subdir, std::cref(pattern),
-                       std::cref(gitignore_rules), std::ref(collector),
-                       std::ref(pool), // always std::ref for thread pool itself
-                       std::ref(active_tasks),
-                       std::ref(output_mtx), // always std::ref for mutex
-                       max_depth, current_depth + 1);
+        // Collect subdirectories for parallel processing
+        if (descend) {
+            subdirs.emplace_back(arena.add(dir, entry.name), std::move(child));
+        }
+    }
+    if (reader.error() != 0 && reader.fd() >= 0) {
+        if (ws) ++ws->errors;
+        filters.errors->add("Error reading", dir_path, reader.error());
+    }
+    if (stats && !stats->empty()) {
+        auto path_of = [&](std::string_view name) -> const std::string& {
+            entry_path.assign(dir_path);
+            if (!entry_path.empty() && entry_path.back() != '/') entry_path += '/';
+            entry_path.append(name);
+            return entry_path;
+        };
+        gutils::PhaseTimer stat_timer(ws, gutils::kStat);
+        stats->run(reader.fd(),
+            [&](std::string_view name, const struct statx& st) {
+                if (filters.du) {
+                    if (S_ISDIR(st.stx_mode)) return;
+                    if (st.stx_nlink > 1 &&
+                        !filters.du->first_link(makedev(st.stx_dev_major, st.stx_dev_minor), st.stx_ino)) {
+                        return;
+                    }
+                    uint64_t bytes = st.stx_blocks * 512;
+                    du_bytes += bytes;
+                    ++du_files;
+                    if (filters.du_extensions) filters.du->add_extension(name, bytes);
+                } else if (filters.dedupe) {
+                    if (S_ISREG(st.stx_mode)) {
+                        filters.dedupe->add(path_of(name), st.stx_size,
+                                            makedev(st.stx_dev_major, st.stx_dev_minor), st.stx_ino);
+                    }
+                } else if (!filters.contains) {
+                    if (filters.limit->take()) {
+                        if (ws) ++ws->matches;
+                        add_result(sink.local(), path_of(name), filters.multi);
+                        if (watched) watched->matches.emplace(name);
+                    }
+                } else if (S_ISREG(st.stx_mode)) {
+                    files.push_back(path_of(name));
+                }
+            },
+            [&](std::string_view name, int err) {
+                if (ws) ++ws->errors;
+                filters.errors->add("Error accessing", path_of(name), err);
+            });
+    }
+    reader.close();
+    if (node) emitter->complete(node);
+    if (filters.du) {
+        filters.du->finish(arena, dir, current_depth, du_bytes, du_files, static_cast<uint32_t>(subdirs.size()));
+    }
+
+    if (filters.limit->cancelled()) {
+        subdirs.clear();
+        files.clear();
+        cancel_pending(pool, active_tasks);
+    }
+
+    // Enqueue subdirectories for parallel processing
+    for (const auto& [subdir, child] : subdirs) {
+      // Whenever you launch work (e.g., a thread, task, closure) inside a loop, and the work needs the current item, capture it by value in the closure.
+      // subdir is captured by value to ensure each thread have their own copy of var (only an arena id now)
+      // print("push ---------subdir:", subdir.string());
+      active_tasks.fetch_add(1, std::memory_order_relaxed);
+      pool.enqueue(fd_search_threaded, subdir, std::ref(arena), std::cref(filters),
+                   ignore, // by value, the shared_ptr keeps the rules alive
+                   std::ref(sink),
+                   emitter, child,
+                   std::ref(pool), // always std::ref for thread pool itself
+                   std::ref(active_tasks),
+                   max_depth, current_depth + 1);
+
+      // pool.enqueue(fd_search_threaded, subdir, arena, filters, ignore, sink, emitter, child, pool, active_tasks, max_depth, current_depth + 1);
+      // pool.enqueue([&, subdir,  max_depth, current_depth]() {
+      //       fd_search_threaded(subdir, arena, filters, ignore, sink, emitter, child, pool, active_tasks, max_depth, current_depth + 1);
+      //   });
+    }
+
+    // file contents are read after the subdirectories are queued, so the walk keeps going meanwhile.
+    // a big directory is split into batches for the other pool threads, this task keeps the first one
+    constexpr size_t kContentBatch = 64;
+    for (size_t begin = kContentBatch; begin < files.size(); begin += kContentBatch) {
+        size_t end = std::min(files.size(), begin + kContentBatch);
+        std::vector<std::string> batch(std::make_move_iterator(files.begin() + begin),
+                                       std::make_move_iterator(files.begin() + end));
+        active_tasks.fetch_add(1, std::memory_order_relaxed);
+        pool.enqueue([&sink, &active_tasks, &filters, batch = std::move(batch)]() {
+            gutils::WalkStats* batch_ws = filters.stats ? &filters.stats->local() : nullptr;
+            if (batch_ws && t_last_task_end != 0) batch_ws->exact[gutils::kQueueWait] += gutils::ticks() - t_last_task_end;
+            fd_search_contents(batch, *filters.contains, *filters.limit, sink, filters.multi, *filters.errors, batch_ws);
+            if (batch_ws) t_last_task_end = gutils::ticks();
+            sink.local().flush_if_stale();
+            active_tasks.fetch_sub(1, std::memory_order_release);
+        });
+    }
+    if (!files.empty()) {
+        files.resize(std::min(files.size(), kContentBatch));
+        fd_search_contents(files, *filters.contains, *filters.limit, sink, filters.multi, *filters.errors, ws);
+    }
+
+    sink.local().flush_if_stale();
+    if (ws) t_last_task_end = gutils::ticks();
+    // release: main reads this thread's output buffer once it sees 0
+    active_tasks.fetch_sub(1, std::memory_order_release);
+}
+
+// Multi-root search: the roots are grouped by st_dev and each device gets its own pool, so its own
+// queue and its own number of workers. A slow disk then only holds up its own roots.
+// A subtree stays on its root's pool, also where it crosses into another mount.
+struct DeviceGroup {
+    gutils::DeviceInfo info;
+    int threads = 0;
+    std::vector<size_t> roots;  // indexes into the root list
+    std::unique_ptr<ThreadPool> pool;
+};
+
+// workers for a spinning disk unless --threads or --device-threads say otherwise, more only adds seeks
+constexpr int kRotationalThreads = 2;
 
-          // pool.enqueue(fd_search_threaded, subdir, pattern, gitignore_rules, collector, pool, active_tasks, output_mtx, max_depth, current_depth + 1);
-          // pool.enqueue([&, subdir,  max_depth, current_depth]() {
-          //       fd_search_threaded(subdir, pattern, gitignore_rules, collector, pool, active_tasks, output_mtx, max_depth, current_depth + 1);
-          //   });
+// threads_given: --threads was on the command line, it then holds for rotational devices too.
+// hdd: every device is treated as rotational (--hdd), whatever --threads says
+std::vector<DeviceGroup> group_by_device(
+    const std::vector<fs::path>& roots,
+    int num_threads,
+    bool threads_given,
+    const std::vector<std::pair<dev_t, int>>& device_threads,
+    bool hdd
+) {
+    std::vector<DeviceGroup> groups;
+    for (size_t i = 0; i < roots.size(); ++i) {
+        struct stat st;
+        if (::stat(roots[i].c_str(), &st) != 0) {
+            std::cerr << "Error accessing " << roots[i] << ": " << std::strerror(errno) << std::endl;
+            continue;
+        }
+        auto it = std::find_if(groups.begin(), groups.end(),
+                               [&](const DeviceGroup& g) { return g.info.dev == st.st_dev; });
+        if (it == groups.end()) {
+            DeviceGroup g;
+            g.info = gutils::device_info(st.st_dev);
+            bool cap = hdd || (g.info.rotational && !threads_given);
+            g.threads = cap ? std::min(num_threads, kRotationalThreads) : num_threads;
+            for (auto& [dev, n] : device_threads) {
+                if (dev == st.st_dev) g.threads = n;
+            }
+            g.threads = std::max(g.threads, 1);
+            groups.push_back(std::move(g));
+            it = groups.end() - 1;
         }
+        it->roots.push_back(i);
+    }
+    return groups;
+}
 
-    } catch (const fs::filesystem_error& e) {
-        std::cerr << "Error accessing " << dir << ": " << e.what() << std::endl;
+// Index mode: match the pattern against the file names of an on-disk index instead of walking the tree.
+// The index is built from dir when it does not exist yet, --update refreshes it first
+// by re-reading only the directories whose mtime changed.
+bool fd_search_index(
+    const std::string& index_file,
+    const fs::path& dir,
+    bool update,
+    const Filters& filters,
+    gutils::OutputSink& sink,
+    bool sorted,
+    int max_depth = -1
+) {
+    std::error_code ec;
+    if (!fs::exists(index_file, ec)) {
+        if (!gutils::build_file_index(dir, index_file)) return false;
+    } else if (update) {
+        auto old = gutils::FileIndex::open(index_file);
+        // a broken old index is rebuilt from scratch
+        if (!gutils::build_file_index(dir, index_file, old.get())) return false;
+    }
+
+    auto index = gutils::FileIndex::open(index_file);
+    if (!index) return false;
+    // the index of another tree would answer silently with its paths. --update rebuilds it for dir
+    if (!index->built_for(dir)) {
+        std::cerr << "Index " << index_file << " was built for " << index->root() << ", not " << dir.string()
+                  << " (--update rebuilds it)" << std::endl;
+        return false;
     }
 
-    active_tasks.fetch_sub(1, std::memory_order_relaxed);
+    // entry 0 is the root itself. the walk lists entries down to depth max_depth + 1
+    std::vector<std::string> matches;
+    std::vector<int> ids;
+    for (uint32_t i = 1; i < index->size(); ++i) {
+        if (!filters.name_matches(index->name(i), ids)) continue;
+        if (max_depth != -1 && index->depth(i) > max_depth + 1) continue;
+        if (filters.meta) {
+            // the type is in the index, everything else is stat'ed now
+            if (!filters.meta->type_ok(index->entry(i).type)) continue;
+            int err = 0;
+            if (filters.meta->needs_stat() && !filters.meta->stat_matches(AT_FDCWD, index->path(i).c_str(), err)) {
+                if (err != 0) filters.errors->add("Error accessing", index->path(i), err);
+                continue;
+            }
+        }
+        if (filters.contains) {
+            // the index knows the names, the contents are read now, one file after another
+            if (index->entry(i).type != DT_REG) continue;
+            int err = 0;
+            if (!filters.contains->file_matches(index->path(i).c_str(), err)) {
+                if (err != 0) filters.errors->add("Error reading", index->path(i), err);
+                continue;
+            }
+        }
+        if (sorted) {
+            matches.push_back(index->path(i));
+        } else {
+            if (!filters.limit->take()) break;
+            add_result(sink.local(), index->path(i), filters.multi);
+        }
+    }
+    // no walk to merge here, the matches are already in memory
+    std::sort(matches.begin(), matches.end(), gutils::path_order_less);
+    for (const auto& m : matches) {
+        if (!filters.limit->take()) break;
+        add_result(sink.local(), m, filters.multi);
+    }
+    return true;
 }
 
+// --watch: set by SIGINT/SIGTERM, the watch loop ends and the output is flushed
+std::atomic<bool> g_stop_watch{false};
+
+void on_stop_signal(int) { g_stop_watch.store(true); }
+
+// --watch: after the initial pass, stream the changes to the result set.
+// Each watched Dir remembers the names it reported. When inotify says something happened to a
+// name, the name is looked at once more and the difference is printed, tab separated:
+// "created\tPATH", "deleted\tPATH" or "renamed\tOLD\tNEW" (a rename both sides of which are
+// results). -e tags follow at the end of the line. With -x/-X the commands get the paths that
+// are new, created or renamed to.
+// A directory created or moved in is read and watched, and its results are printed as created;
+// one deleted or moved away takes its results with it. After an inotify queue overflow, and
+// every kUnwatchedRescan for the directories the watch limit left out, the directories whose
+// mtime changed are read again and compared.
+class Watch {
+public:
+    static constexpr std::chrono::seconds kUnwatchedRescan{30};
+
+    Watch(gutils::DirWatcher& watcher, const Filters& filters, gutils::OutputSink& sink, bool exec, int max_depth)
+        : watcher_(watcher), filters_(filters), sink_(sink), exec_(exec), max_depth_(max_depth) {}
+
+    // until SIGINT or SIGTERM
+    void run() {
+        struct sigaction sa{};
+        sa.sa_handler = on_stop_signal;  // no SA_RESTART, poll returns with EINTR
+        sigaction(SIGINT, &sa, nullptr);
+        sigaction(SIGTERM, &sa, nullptr);
+        std::cerr << "Watching " << watcher_.dirs().size() << " directories" << std::endl;
+
+        gutils::DirWatcher::Batch batch;
+        auto last_rescan = std::chrono::steady_clock::now();
+        while (!g_stop_watch.load()) {
+            if (watcher_.wait(batch, 500)) {
+                if (batch.overflow) {
+                    std::cerr << "inotify queue overflow, rescanning changed directories" << std::endl;
+                    rescan(watcher_.dirs());
+                } else {
+                    handle(batch);
+                }
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now - last_rescan >= kUnwatchedRescan) {
+                rescan(watcher_.unwatched());
+                last_rescan = now;
+            }
+            sink_.local().flush();
+        }
+    }
+
+private:
+    struct State {
+        std::string path;
+        bool before;
+        bool now;
+        std::string tags;
+        bool new_dir;  // a directory that is not watched yet, to be read
+    };
+
+    static std::string join(const std::string& dir, std::string_view name) {
+        std::string p = dir;
+        if (p.empty() || p.back() != '/') p += '/';
+        p += name;
+        return p;
+    }
+
+    bool descend(const gutils::DirWatcher::Dir& parent) const {
+        return max_depth_ == -1 || parent.depth < max_depth_;
+    }
+
+    // dir/name is a result now: the same checks as the walk, cheapest first. st is its lstat
+    // (stat with --follow) when the caller has it already, null to stat only after the name matched
+    bool result(const gutils::DirWatcher::Dir& dir, std::string_view name, const std::string& path,
+                const struct stat* st, std::string& tags) {
+        tags.clear();
+        if (!filters_.name_matches(name, ids_)) return false;
+        struct stat own;
+        if (!st) {
+            if (!stat_path(path, own)) return false;
+            st = &own;
+        }
+        if (gutils::is_ignored(dir.ignore, path, S_ISDIR(st->st_mode))) return false;
+        if (filters_.meta) {
+            if (!filters_.meta->type_ok(IFTODT(st->st_mode))) return false;
+            int err = 0;
+            if (filters_.meta->needs_stat() && !filters_.meta->stat_matches(AT_FDCWD, path.c_str(), err)) return false;
+        }
+        if (filters_.multi) filters_.multi->tags(ids_, tags);
+        return true;
+    }
+
+    bool stat_path(const std::string& path, struct stat& st) const {
+        return (filters_.visited ? ::stat(path.c_str(), &st) : ::lstat(path.c_str(), &st)) == 0;
+    }
+
+    void emit(const char* kind, const std::string& path, std::string_view tags, const std::string* to = nullptr) {
+        if (exec_) {
+            if (std::strcmp(kind, "deleted") != 0) sink_.local().add(to ? *to : path);
+            return;
+        }
+        line_.assign(kind);
+        line_ += '\t';
+        line_ += path;
+        if (to) {
+            line_ += '\t';
+            line_ += *to;
+        }
+        if (!tags.empty()) {
+            line_ += '\t';
+            line_.append(tags);
+        }
+        sink_.local().add(line_);
+    }
+
+    // a watched directory went away: its results and those of everything below it are deleted
+    void dir_gone(const std::string& path) {
+        std::string tags;
+        watcher_.remove_tree(path, [&](gutils::DirWatcher::Dir& d) {
+            for (const auto& name : d.matches) {
+                if (filters_.multi) filters_.multi->tags_of(name, tags);
+                emit("deleted", join(d.path, name), tags);
+            }
+            d.matches.clear();
+        });
+    }
+
+    // a directory new to the watch, and everything below it: watched, then read.
+    // the results are printed as created
+    void scan(const std::string& path, const gutils::IgnoreStack& parent_ignore, int depth) {
+        struct Todo {
+            std::string path;
+            gutils::IgnoreStack ignore;
+            int depth;
+        };
+        std::vector<Todo> todo{{path, parent_ignore, depth}};
+        std::string child;
+        std::string tags;
+        while (!todo.empty()) {
+            Todo t = std::move(todo.back());
+            todo.pop_back();
+            if (!reader_.open(t.path.c_str())) continue;
+            gutils::DirWatcher::Dir* d =
+                watcher_.add(t.path, gutils::IgnoreNode::enter(reader_.fd(), t.path, t.ignore), t.depth, reader_.fd());
+            gutils::DirEntry entry;
+            while (reader_.next(entry)) {
+                child = join(t.path, entry.name);
+                unsigned char type = filters_.visited ? reader_.follow_type(entry) : reader_.resolve_type(entry);
+                if (result(*d, entry.name, child, nullptr, tags)) {
+                    d->matches.emplace(entry.name);
+                    emit("created", child, tags);
+                }
+                if (type == DT_DIR && descend(*d) && !gutils::is_ignored(d->ignore, child, true)) {
+                    todo.push_back(Todo{child, d->ignore, t.depth + 1});
+                }
+            }
+            reader_.close();
+        }
+    }
+
+    void handle(const gutils::DirWatcher::Batch& batch) {
+        // first what every name was and is now. directories that went away are dropped on the way
+        states_.clear();
+        struct stat st;
+        for (const auto& c : batch.changes) {
+            State s{join(c.dir->path, c.name), false, false, std::string(), false};
+            if (c.dir->gone) {
+                // below a directory dropped earlier in this batch, its results went with it
+                states_.push_back(std::move(s));
+                continue;
+            }
+            bool exists = stat_path(s.path, st);
+            bool is_dir = exists && S_ISDIR(st.st_mode);
+            gutils::DirWatcher::Dir* child = c.is_dir || is_dir ? watcher_.find(s.path) : nullptr;
+            if (child && (!is_dir || st.st_ino != child->ino || st.st_dev != child->dev)) {
+                dir_gone(s.path);
+                child = nullptr;
+            }
+            s.before = c.dir->matches.count(c.name) > 0;
+            s.now = exists && result(*c.dir, c.name, s.path, &st, s.tags);
+            if (s.now) {
+                c.dir->matches.emplace(c.name);
+            } else {
+                c.dir->matches.erase(c.name);
+            }
+            s.new_dir = !child && is_dir && descend(*c.dir) && !gutils::is_ignored(c.dir->ignore, s.path, true);
+            states_.push_back(std::move(s));
+        }
+        // a rename with a result on both sides is one line, not a deleted and a created
+        std::vector<bool> done(states_.size());
+        for (auto [from, to] : batch.renames) {
+            State& a = states_[from];
+            State& b = states_[to];
+            if (a.before && !a.now && !b.before && b.now && !done[from] && !done[to]) {
+                emit("renamed", a.path, b.tags, &b.path);
+                done[from] = done[to] = true;
+            }
+        }
+        for (size_t i = 0; i < states_.size(); ++i) {
+            const State& s = states_[i];
+            if (!done[i] && s.before != s.now) emit(s.now ? "created" : "deleted", s.path, s.tags);
+            if (s.new_dir && !batch.changes[i].dir->gone) {
+                const auto& parent = *batch.changes[i].dir;
+                scan(s.path, parent.ignore, parent.depth + 1);
+            }
+        }
+    }
+
+    // events were lost (or never came, for unwatched directories): the directories that are
+    // gone are dropped, those whose mtime changed are read again and compared
+    void rescan(const std::vector<gutils::DirWatcher::Dir*>& dirs) {
+        struct stat st;
+        for (auto* d : dirs) {
+            if (d->gone) continue;
+            if (::stat(d->path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || st.st_ino != d->ino || st.st_dev != d->dev) {
+                dir_gone(d->path);
+            }
+        }
+        std::string child;
+        std::string tags;
+        std::vector<std::string> new_dirs;
+        for (auto* d : dirs) {
+            if (d->gone) continue;
+            if (!reader_.open(d->path.c_str())) continue;
+            if (::fstat(reader_.fd(), &st) != 0 ||
+                (st.st_mtim.tv_sec == d->mtime.tv_sec && st.st_mtim.tv_nsec == d->mtime.tv_nsec)) {
+                reader_.close();
+                continue;
+            }
+            d->mtime = st.st_mtim;
+            std::unordered_set<std::string> now;
+            new_dirs.clear();
+            gutils::DirEntry entry;
+            while (reader_.next(entry)) {
+                child = join(d->path, entry.name);
+                unsigned char type = filters_.visited ? reader_.follow_type(entry) : reader_.resolve_type(entry);
+                if (result(*d, entry.name, child, nullptr, tags)) {
+                    now.emplace(entry.name);
+                    if (!d->matches.count(std::string(entry.name))) emit("created", child, tags);
+                }
+                if (type == DT_DIR && descend(*d) && !gutils::is_ignored(d->ignore, child, true) &&
+                    !watcher_.find(child)) {
+                    new_dirs.push_back(child);
+                }
+            }
+            reader_.close();
+            for (const auto& name : d->matches) {
+                if (now.count(name)) continue;
+                if (filters_.multi) filters_.multi->tags_of(name, tags);
+                emit("deleted", join(d->path, name), tags);
+            }
+            d->matches = std::move(now);
+            for (const auto& dir : new_dirs) scan(dir, d->ignore, d->depth + 1);
+        }
+    }
+
+    gutils::DirWatcher& watcher_;
+    const Filters& filters_;
+    gutils::OutputSink& sink_;
+    bool exec_;
+    int max_depth_;
+    gutils::DirReader reader_;
+    std::vector<int> ids_;
+    std::vector<State> states_;
+    std::string line_;
+};
+
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <pattern> [directory] [--case-sensitive] [--max-depth N] [--threads N]\n";
+        std::cerr << "Usage: " << argv[0] << " <pattern> [directory] [--case-sensitive] [--max-depth N] [--threads N] [--index FILE [--update]] [--sorted] [--contains REGEX] [--type f|d|l|p|s|x] [--size [+-]N[unit]] [--changed-within N[unit]] [--owner USER[:GROUP]] [--io-uring] [--max-results N | --first] [--follow] [--hdd] [--stats [json]] [--root DIR]... [--device-threads ROOT=N]... [-e PATTERN[=TAG]]... [--dedupe] [--du [N] [--by-ext]] [--watch] [--quiet-errors] [-x|-X CMD... [;]]\n"
+                  << "  -e PATTERN[=TAG]: the tag is what follows the last '=', a pattern with '=' in it needs one or a trailing '=' (-e 'a=b=')\n";
         return 1;
     }
 
     // Parse arguments
-    std::string pattern_str = gutils::glob_to_regex(argv[1]);
+    std::string pattern_str = argv[1];
     fs::path dir = (argc > 2) ? argv[2] : ".";
     bool case_sensitive = false;
     int max_depth = -1;
     int num_threads = std::thread::hardware_concurrency();
+    bool threads_given = false;
+    std::string index_file;
+    bool update_index = false;
+    bool sorted = false;
+    // -x: one process per result, -X: as many results per process as fit
+    std::vector<std::string> exec_cmd;
+    bool exec_batch = false;
+    std::string contains_str;
+    bool has_contains = false;
+    gutils::MetaFilter meta;
+    bool io_uring = false;
+    uint64_t max_results = 0;
+    bool follow = false;
+    bool hdd = false;
+    // --stats: per phase timings on stderr at the end, --stats json for one JSON object
+    bool show_stats = false;
+    bool stats_json = false;
+    // errors are still counted, but not listed
+    bool quiet_errors = false;
+    // argv[2] plus every --root
+    std::vector<fs::path> roots = {dir};
+    std::vector<std::pair<dev_t, int>> device_threads;
+    // -e: more patterns for the same walk, argv[1] is the first of them
+    std::vector<std::string> extra_patterns;
+    // --dedupe: print groups of files with the same contents instead of the matches
+    bool dedupe_mode = false;
+    // --du: the N largest directories instead of the matches, --max-depth limits the report, not the walk.
+    // .gitignore rules do not apply, the totals are those of du
+    bool du_mode = false;
+    size_t du_top = 20;
+    bool du_extensions = false;
+    // --watch: after the initial pass, print the changes to the results until interrupted
+    bool watch_mode = false;
+    std::string meta_error;
 
     // Parse command line arguments
     for (int i = 3; i < argc; ++i) {
@@ -186,48 +930,331 @@ int main(int argc, char* argv[]) {
             max_depth = std::stoi(argv[++i]);
         } else if (arg == "--threads" && i + 1 < argc) {
             num_threads = std::stoi(argv[++i]);
+            threads_given = true;
+        } else if (arg == "--index" && i + 1 < argc) {
+            index_file = argv[++i];
+        } else if (arg == "--update") {
+            update_index = true;
+        } else if (arg == "--sorted") {
+            sorted = true;
+        } else if ((arg == "-x" || arg == "-X") && i + 1 < argc) {
+            exec_batch = arg == "-X";
+            // the command takes the rest of the line, up to an optional ";"
+            while (++i < argc && std::string(argv[i]) != ";") exec_cmd.push_back(argv[i]);
+        } else if (arg == "--type" && i + 1 < argc) {
+            if (!meta.add_type(argv[++i], meta_error)) break;
+        } else if (arg == "--size" && i + 1 < argc) {
+            if (!meta.add_size(argv[++i], meta_error)) break;
+        } else if (arg == "--changed-within" && i + 1 < argc) {
+            if (!meta.set_changed_within(argv[++i], meta_error)) break;
+        } else if (arg == "--owner" && i + 1 < argc) {
+            if (!meta.set_owner(argv[++i], meta_error)) break;
+        } else if (arg == "--io-uring") {
+            io_uring = true;
+        } else if (arg == "--max-results" && i + 1 < argc) {
+            max_results = std::stoull(argv[++i]);
+        } else if (arg == "--first") {
+            max_results = 1;
+        } else if (arg == "--follow") {
+            follow = true;
+        } else if (arg == "--hdd") {
+            hdd = true;
+        } else if (arg == "--stats") {
+            show_stats = true;
+            if (i + 1 < argc && std::string(argv[i + 1]) == "json") {
+                stats_json = true;
+                ++i;
+            }
+        } else if (arg == "--root" && i + 1 < argc) {
+            roots.emplace_back(argv[++i]);
+        } else if (arg == "--device-threads" && i + 1 < argc) {
+            // ROOT=N: N workers for the device ROOT is on
+            std::string spec = argv[++i];
+            size_t eq = spec.rfind('=');
+            struct stat st;
+            if (eq == std::string::npos || ::stat(spec.substr(0, eq).c_str(), &st) != 0) {
+                std::cerr << "Invalid --device-threads " << spec << ", expected an existing ROOT=N" << std::endl;
+                return 1;
+            }
+            device_threads.emplace_back(st.st_dev, std::stoi(spec.substr(eq + 1)));
+        } else if (arg == "--dedupe") {
+            dedupe_mode = true;
+        } else if (arg == "--du") {
+            du_mode = true;
+            if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) du_top = std::stoull(argv[++i]);
+        } else if (arg == "--by-ext") {
+            du_extensions = true;
+        } else if (arg == "--watch") {
+            watch_mode = true;
+        } else if (arg == "--quiet-errors") {
+            quiet_errors = true;
+        } else if (arg == "-e" && i + 1 < argc) {
+            extra_patterns.push_back(argv[++i]);
+        } else if (arg == "--contains" && i + 1 < argc) {
+            contains_str = argv[++i];
+            has_contains = true;
         }
     }
 
-    // Compile regex with case-insensitive flag if needed
-    RE2::Options options;
-    options.set_case_sensitive(case_sensitive);
+    if (!meta_error.empty()) {
+      std::cerr << "Invalid filter: " << meta_error << std::endl;
+      return 1;
+    }
+    if (dedupe_mode) {
+      if (has_contains || !index_file.empty() || !extra_patterns.empty() || !exec_cmd.empty() || max_results != 0) {
+        std::cerr << "--dedupe cannot be combined with --contains, --index, -e, -x/-X or --max-results" << std::endl;
+        return 1;
+      }
+      // size and inode come with the statx the metadata filters batch per directory anyway
+      meta.require(STATX_SIZE | STATX_INO);
+      // the groups are written sorted once the search is done
+      sorted = false;
+    }
+    int du_depth = -1;
+    if (du_mode) {
+      if (has_contains || !index_file.empty() || !extra_patterns.empty() || !exec_cmd.empty() || max_results != 0 ||
+          dedupe_mode) {
+        std::cerr << "--du cannot be combined with --contains, --index, -e, -x/-X, --max-results or --dedupe" << std::endl;
+        return 1;
+      }
+      meta.require(STATX_BLOCKS | STATX_INO | STATX_NLINK);
+      sorted = false;
+      // like du --max-depth: everything is walked and counted, the report stops at that depth
+      du_depth = max_depth;
+      max_depth = -1;
+    } else if (du_extensions) {
+      std::cerr << "--by-ext needs --du" << std::endl;
+      return 1;
+    }
+    if (watch_mode && (has_contains || !index_file.empty() || max_results != 0 || dedupe_mode || du_mode)) {
+      std::cerr << "--watch cannot be combined with --contains, --index, --max-results, --dedupe or --du" << std::endl;
+      return 1;
+    }
 
-    auto pattern = make_unique<RE2>(pattern_str, options);
-    if(!pattern->ok()){
-      std::cerr << "Invalid regex pattern: " << pattern->error() << std::endl;
+    // literal shapes like *.log are matched without RE2, the rest is compiled to a regex
+    gutils::NameMatcher pattern(pattern_str, case_sensitive);
+    if(!pattern.ok()){
+      std::cerr << "Invalid regex pattern: " << pattern.error() << std::endl;
       return 1;
     }
 
-    std::vector<unique_ptr<RE2>> gitignore_rules = gutils::load_gitignore_rules(dir);
+    // -e: every name is matched against all patterns at once, each line says which ones matched.
+    // the pattern ids are the tags where no =TAG is given
+    std::unique_ptr<gutils::MultiMatcher> multi;
+    if (!extra_patterns.empty()) {
+      if (!exec_cmd.empty()) {
+        std::cerr << "-e tags the output lines, it cannot be combined with -x/-X" << std::endl;
+        return 1;
+      }
+      std::vector<gutils::TaggedPattern> patterns = {gutils::parse_tagged_pattern(pattern_str, 0)};
+      for (const auto& spec : extra_patterns) {
+        patterns.push_back(gutils::parse_tagged_pattern(spec, patterns.size()));
+      }
+      multi = make_unique<gutils::MultiMatcher>(std::move(patterns), case_sensitive);
+      if (!multi->ok()) {
+        std::cerr << "Invalid pattern " << multi->error() << std::endl;
+        return 1;
+      }
+    }
+
+    std::unique_ptr<gutils::ContentMatcher> contains;
+    if (has_contains) {
+      contains = make_unique<gutils::ContentMatcher>(contains_str);
+      if (!contains->ok()) {
+        std::cerr << "Invalid content pattern: " << contains->error() << std::endl;
+        return 1;
+      }
+    }
 
-    ResultCollector collector;
+    // the search stops once max_results are out, 0 is no limit
+    gutils::ResultLimit limit(max_results);
+    std::unique_ptr<gutils::VisitedSet> visited;
+    if (follow) visited = make_unique<gutils::VisitedSet>();
+    meta.set_follow(follow);
+    Filters filters{pattern, meta.active() ? &meta : nullptr, io_uring, contains.get(), &limit, visited.get(), hdd};
+    filters.multi = multi.get();
+    // the walk only notes errors, they are listed once it is done
+    gutils::ErrorLog errors(quiet_errors);
+    filters.errors = &errors;
+    std::unique_ptr<gutils::DirWatcher> watcher;
+    if (watch_mode) {
+      std::string watch_error;
+      watcher = gutils::DirWatcher::create(watch_error);
+      if (!watcher) {
+        std::cerr << "Cannot watch: " << watch_error << std::endl;
+        return 1;
+      }
+      filters.watcher = watcher.get();
+    }
+    std::unique_ptr<gutils::StatsRegistry> stats_registry;
+    if (show_stats) {
+      stats_registry = make_unique<gutils::StatsRegistry>();
+      filters.stats = stats_registry.get();
+    }
+
+    // .gitignore files are loaded as the walk enters each directory
+
+    // results are written while the search runs, by one writer thread in large chunks
+    // with -x/-X the results go to the commands instead of stdout, they start while the walk goes on.
+    // --threads also limits how many commands run at once
+    std::unique_ptr<gutils::ExecRunner> exec;
+    if (!exec_cmd.empty()) exec = make_unique<gutils::ExecRunner>(exec_cmd, exec_batch, num_threads);
+    auto sink_ptr = exec
+        ? make_unique<gutils::OutputSink>([&exec](std::string_view chunk) { exec->feed(chunk); })
+        : make_unique<gutils::OutputSink>();
+    gutils::OutputSink& sink = *sink_ptr;
+    std::unique_ptr<gutils::OrderedEmitter> emitter;
+    if (sorted) {
+      emitter = make_unique<gutils::OrderedEmitter>(sink);
+      // with --sorted the first N in output order count, not the first N found
+      emitter->set_limit(&limit);
+    }
     auto start_time = std::chrono::high_resolution_clock::now();
-    // {
-      // Create thread pool and result collector
-      ThreadPool pool(num_threads);
-      std::atomic<int> active_tasks(1);
+    int total_threads = num_threads;
+    std::unique_ptr<gutils::DuplicateFinder> dedupe;
+    // directories queued by the walk, one arena per root. declared before the pools so they
+    // outlive the pool threads, and out here so the --du report can still build paths
+    std::vector<std::unique_ptr<gutils::PathArena>> arenas;
+    std::unique_ptr<gutils::DiskUsage> du;
+    if (!index_file.empty()) {
+      if (roots.size() > 1) {
+        std::cerr << "--index takes a single root" << std::endl;
+        return 1;
+      }
+      if (!fd_search_index(index_file, dir, update_index, filters, sink, sorted, max_depth)) {
+        return 1;
+      }
+    } else {
+      for (const auto& root : roots) arenas.push_back(make_unique<gutils::PathArena>(root.native()));
+      std::vector<DeviceGroup> groups = group_by_device(roots, num_threads, threads_given, device_threads, hdd);
+      if (du_mode) {
+        du = make_unique<gutils::DiskUsage>();
+        for (const auto& arena : arenas) du->add_root(*arena);
+        filters.du = du.get();
+        filters.du_extensions = du_extensions;
+      }
+
+      // --sorted writes the roots in the order given, the emitter starts with the last root() it got
+      std::vector<gutils::OrderedEmitter::NodePtr> nodes(roots.size());
+      if (emitter) {
+        for (size_t r = roots.size(); r-- > 0;) nodes[r] = emitter->root(roots[r].native());
+        // a root that could not be stat'ed is in no group, it is written as empty
+        std::vector<bool> queued(roots.size());
+        for (auto& g : groups) {
+          for (size_t r : g.roots) queued[r] = true;
+        }
+        for (size_t r = 0; r < roots.size(); ++r) {
+          if (!queued[r]) emitter->complete(nodes[r]);
+        }
+      }
 
-      std::mutex output_mtx;
+      std::atomic<int> active_tasks(0);
+      for (auto& g : groups) active_tasks.fetch_add(static_cast<int>(g.roots.size()));
+      total_threads = 0;
+      for (auto& g : groups) {
+        // Create thread pool
+        g.pool = make_unique<ThreadPool>(g.threads);
+        total_threads += g.threads;
+        if (groups.size() > 1) {
+          std::cerr << "device " << (g.info.block ? g.info.name : "(no block device)")
+                    << (g.info.rotational ? " rotational" : "") << ": " << g.threads << " threads, "
+                    << g.roots.size() << " root(s)" << std::endl;
+        }
+      }
 
-      // Use the thread pool approach for better resource management
-      fd_search_threaded(dir, pattern, gitignore_rules, collector, pool, active_tasks, output_mtx, max_depth, 0);
+      if (dedupe_mode) {
+        // the hashing runs on the pool of the file's device, a file on a device no root is on
+        // (below a mount point) goes to the first pool. counted in active_tasks like the walk
+        dedupe = make_unique<gutils::DuplicateFinder>([&](dev_t dev, std::function<void()> task) {
+          ThreadPool* pool = groups.front().pool.get();
+          for (auto& g : groups) {
+            if (g.info.dev == dev) pool = g.pool.get();
+          }
+          active_tasks.fetch_add(1, std::memory_order_relaxed);
+          pool->enqueue([&filters, &active_tasks, task = std::move(task)]() {
+            gutils::WalkStats* hash_ws = filters.stats ? &filters.stats->local() : nullptr;
+            if (hash_ws && t_last_task_end != 0) hash_ws->exact[gutils::kQueueWait] += gutils::ticks() - t_last_task_end;
+            {
+              gutils::PhaseTimer hash_timer(hash_ws, gutils::kContents);
+              task();
+            }
+            if (hash_ws) t_last_task_end = gutils::ticks();
+            active_tasks.fetch_sub(1, std::memory_order_release);
+          });
+        }, errors);
+        filters.dedupe = dedupe.get();
+      }
+
+      for (auto& g : groups) {
+        for (size_t r : g.roots) {
+          g.pool->enqueue(fd_search_threaded, gutils::PathArena::kRoot, std::ref(*arenas[r]), std::cref(filters),
+                          gutils::IgnoreStack(), std::ref(sink), emitter.get(), nodes[r],
+                          std::ref(*g.pool), std::ref(active_tasks), max_depth, 0);
+        }
+      }
 
       // Wait for all tasks to complete
       while (active_tasks.load() > 0) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        // after a cancel only the running tasks are left, they are done within a directory
+        std::this_thread::sleep_for(std::chrono::milliseconds(limit.limited() ? 1 : 10));
       }
-
-    // }
+    }
     // std::cout << "pool dtor.....\n";
+    // the pool threads are joined, their buffers can be flushed
+    if (emitter) emitter->finish();
+    errors.report(std::cerr);
+    if (watcher) {
+      // the initial pass goes out first, then the changes as they come
+      sink.flush();
+      Watch(*watcher, filters, sink, exec != nullptr, max_depth).run();
+    }
+    // --dedupe and --du: the lines of the report, the empty ones between its parts not counted
+    uint64_t report_lines = 0;
+    if (dedupe) {
+      // one path per line, an empty line between groups like fdupes
+      uint64_t extra_bytes = 0;
+      auto dup_groups = dedupe->groups();
+      for (size_t i = 0; i < dup_groups.size(); ++i) {
+        if (i > 0) sink.local().add("");
+        for (const auto& path : dup_groups[i].paths) sink.local().add(path);
+        report_lines += dup_groups[i].paths.size();
+        extra_bytes += (dup_groups[i].paths.size() - 1) * dup_groups[i].size;
+      }
+      gutils::DuplicateFinder::Counts c = dedupe->counts();
+      std::cerr << dup_groups.size() << " groups of duplicates, " << extra_bytes << " bytes in the extra copies. "
+                << c.files << " files, " << c.links << " more hard links, " << c.partial << " partial and "
+                << c.full << " full hashes, " << c.errors << " unreadable" << std::endl;
+    }
+    if (du) {
+      // bytes, files and path per line like du -b, the largest first. the extensions after an empty line
+      std::string line;
+      auto add_entry = [&](const gutils::DiskUsage::Entry& e, std::string_view name) {
+        line = std::to_string(e.bytes) + '\t' + std::to_string(e.files) + '\t';
+        line.append(name);
+        sink.local().add(line);
+      };
+      auto top = du->top(du_top, du_depth);
+      for (const auto& e : top) add_entry(e, e.name);
+      report_lines = top.size();
+      if (du_extensions) {
+        sink.local().add("");
+        auto extensions = du->extensions();
+        for (const auto& e : extensions) add_entry(e, e.name.empty() ? "(none)" : e.name);
+        report_lines += extensions.size();
+      }
+      for (const auto& r : du->roots()) {
+        std::cerr << r.name << ": " << r.bytes << " bytes in " << r.files << " files" << std::endl;
+      }
+    }
+    sink.close();
+    g_count = dedupe || du ? report_lines : sink.lines();
+    int status = exec ? exec->finish() : 0;
     auto end_time = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-    // Print results
-    std::cerr << "Search completed in " << duration.count() << " ms using " << num_threads << " threads" << std::endl;
-
-    collector.print_results();
-
+    std::cerr << "Search completed in " << duration.count() << " ms using " << total_threads << " threads" << std::endl;
+    // the index search does not walk, there is nothing to report for it
+    if (stats_registry && index_file.empty()) stats_registry->report(std::cerr, stats_json, duration.count());
 
     std::cout << g_count << '\n';
-    return 0;
+    return status;
 }
@@ -0,0 +1,470 @@
+/**
+ * Benchmark for the fd engines (cpp_fd, cpp_fd2, cpp_fd3, cpp_fd4).
+ * Generates a synthetic tree from a fixed seed, in tmpfs and/or on disk, runs every engine on it
+ * with warm and cold caches across thread counts and prints the numbers as JSON:
+ * wall time, entries/sec, peak RSS and (with --syscalls) syscall counts.
+ *
+ * cpp_fdbench --fanout 4 --depth 5 --files 20 --threads 1,4,8 > bench.json
+ *
+ * An engine can carry its own flags: --engines "cpp_fd4,cpp_fd4 --hdd". Cold runs on a block
+ * device also report what the device did, from /sys/dev/block/MAJ:MIN/stat: read requests,
+ * sectors and the time spent reading. Fewer requests for the same sectors and less read time
+ * at the same entries is the seek reduction --hdd is after.
+ *
+ * Cold runs write to /proc/sys/vm/drop_caches, that needs root. Without it the cold runs are
+ * skipped and "cold_cache" says why. Syscalls are counted in an extra run under ptrace,
+ * the timed runs are never traced.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <sys/vfs.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <linux/magic.h>
+
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+extern char** environ;
+
+struct TreeSpec {
+    int fanout = 4;            // subdirectories per directory
+    int depth = 5;             // levels below the root
+    int files = 20;            // files per directory
+    int name_min = 4;          // name length, uniform in [name_min, name_max]
+    int name_max = 24;
+    double ignore_density = 0.1;  // share of directories that get a .gitignore
+    uint32_t seed = 42;
+};
+
+struct TreeStats {
+    uint64_t dirs = 0;
+    uint64_t files = 0;
+    uint64_t ignore_files = 0;
+};
+
+class TreeGenerator {
+public:
+    explicit TreeGenerator(const TreeSpec& spec) : spec_(spec), rng_(spec.seed) {}
+
+    bool generate(const fs::path& root, TreeStats& stats) {
+        std::error_code ec;
+        fs::create_directories(root, ec);
+        if (ec) {
+            std::cerr << "Error creating " << root << ": " << ec.message() << std::endl;
+            return false;
+        }
+        return fill(root.native(), 0, stats);
+    }
+
+private:
+    // random lower case name, the index keeps siblings unique
+    std::string name(size_t index) {
+        std::uniform_int_distribution<int> len(spec_.name_min, std::max(spec_.name_min, spec_.name_max));
+        std::uniform_int_distribution<int> letter('a', 'z');
+        std::string s = std::to_string(index) + "_";
+        for (int n = len(rng_); static_cast<int>(s.size()) < n;) s += static_cast<char>(letter(rng_));
+        return s;
+    }
+
+    bool touch(const std::string& path) {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            std::cerr << "Error creating " << path << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        ::close(fd);
+        return true;
+    }
+
+    bool fill(const std::string& dir, int level, TreeStats& stats) {
+        ++stats.dirs;
+        static const char* kExt[] = {".txt", ".c", ".h", ".log", ".tmp", ".json", ".md", ""};
+        std::uniform_int_distribution<size_t> ext(0, std::size(kExt) - 1);
+        for (int i = 0; i < spec_.files; ++i) {
+            if (!touch(dir + "/" + name(i) + kExt[ext(rng_)])) return false;
+            ++stats.files;
+        }
+        std::bernoulli_distribution ignored(spec_.ignore_density);
+        if (ignored(rng_)) {
+            int fd = ::open((dir + "/.gitignore").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd >= 0) {
+                static const char kRules[] = "*.tmp\n*.log\n";
+                ssize_t n = ::write(fd, kRules, sizeof(kRules) - 1);
+                (void)n;
+                ::close(fd);
+                ++stats.ignore_files;
+                ++stats.files;
+            }
+        }
+        if (level >= spec_.depth) return true;
+        for (int i = 0; i < spec_.fanout; ++i) {
+            std::string sub = dir + "/" + name(i);
+            if (::mkdir(sub.c_str(), 0755) != 0) {
+                std::cerr << "Error creating " << sub << ": " << std::strerror(errno) << std::endl;
+                return false;
+            }
+            if (!fill(sub, level + 1, stats)) return false;
+        }
+        return true;
+    }
+
+    TreeSpec spec_;
+    std::mt19937 rng_;
+};
+
+struct RunResult {
+    double wall_ms = 0;
+    long peak_rss_kb = 0;
+    int exit_code = -1;
+};
+
+// stdout and stderr of the engine go to /dev/null, only the child's own rusage is measured
+RunResult run_once(const std::vector<std::string>& args) {
+    RunResult r;
+    std::vector<char*> argv;
+    for (auto& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid;
+    int rc = ::posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (rc != 0) {
+        std::cerr << "Error executing " << args[0] << ": " << std::strerror(rc) << std::endl;
+        return r;
+    }
+    int status = 0;
+    struct rusage ru {};
+    while (::wait4(pid, &status, 0, &ru) < 0 && errno == EINTR) {}
+    auto end = std::chrono::steady_clock::now();
+
+    r.wall_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    r.peak_rss_kb = ru.ru_maxrss;
+    r.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    return r;
+}
+
+// Runs the engine once under ptrace and counts syscall entries of all its threads.
+// false when tracing is not permitted (e.g. seccomp or yama in a container)
+bool count_syscalls(const std::vector<std::string>& args, std::map<long, uint64_t>& counts) {
+    pid_t pid = ::fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        int null = ::open("/dev/null", O_WRONLY);
+        ::dup2(null, 1);
+        ::dup2(null, 2);
+        std::vector<char*> argv;
+        for (auto& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+        argv.push_back(nullptr);
+        if (::ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) != 0) _exit(126);
+        ::execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status = 0;
+    // first stop: SIGTRAP after execv
+    if (::waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status)) return false;
+    long opts = PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_TRACEFORK |
+                PTRACE_O_TRACEVFORK | PTRACE_O_EXITKILL;
+    if (::ptrace(PTRACE_SETOPTIONS, pid, nullptr, opts) != 0 ||
+        ::ptrace(PTRACE_SYSCALL, pid, nullptr, nullptr) != 0) {
+        ::kill(pid, SIGKILL);
+        ::waitpid(pid, &status, 0);
+        return false;
+    }
+
+    while (true) {
+        pid_t tid = ::waitpid(-1, &status, __WALL);
+        if (tid < 0) {
+            if (errno == EINTR) continue;
+            break;  // ECHILD: every traced thread and process is gone
+        }
+        if (!WIFSTOPPED(status)) continue;
+        int sig = WSTOPSIG(status);
+        int inject = 0;
+        if (sig == (SIGTRAP | 0x80)) {
+            __ptrace_syscall_info info {};
+            if (::ptrace(PTRACE_GET_SYSCALL_INFO, tid, sizeof(info), &info) > 0 &&
+                info.op == PTRACE_SYSCALL_INFO_ENTRY) {
+                ++counts[static_cast<long>(info.entry.nr)];
+            }
+        } else if (sig != SIGTRAP && sig != SIGSTOP) {
+            // a real signal for the engine, not a ptrace event or the initial stop of a new thread
+            inject = sig;
+        }
+        ::ptrace(PTRACE_SYSCALL, tid, nullptr, reinterpret_cast<void*>(static_cast<long>(inject)));
+    }
+    return true;
+}
+
+json syscall_json(const std::map<long, uint64_t>& counts) {
+    // the calls a directory walk is made of, everything else only shows up in total
+    static const std::pair<long, const char*> kNames[] = {
+        {SYS_getdents64, "getdents64"}, {SYS_openat, "openat"}, {SYS_close, "close"},
+        {SYS_newfstatat, "newfstatat"}, {SYS_fstat, "fstat"},
+#ifdef SYS_statx
+        {SYS_statx, "statx"},
+#endif
+        {SYS_read, "read"}, {SYS_write, "write"}, {SYS_writev, "writev"},
+        {SYS_mmap, "mmap"}, {SYS_munmap, "munmap"}, {SYS_futex, "futex"}, {SYS_clone, "clone"},
+#ifdef SYS_clone3
+        {SYS_clone3, "clone3"},
+#endif
+    };
+    json j;
+    uint64_t total = 0;
+    for (auto& [nr, n] : counts) total += n;
+    j["total"] = total;
+    for (auto& [nr, name] : kNames) {
+        auto it = counts.find(nr);
+        j[name] = it == counts.end() ? 0 : it->second;
+    }
+    return j;
+}
+
+// read side of a block device's I/O counters, see Documentation/block/stat.rst
+struct DiskStats {
+    uint64_t reads = 0;         // completed read requests, after merging
+    uint64_t sectors = 0;       // 512 byte sectors read
+    uint64_t read_ms = 0;       // time the read requests took, summed over requests
+};
+
+// false for anonymous devices (tmpfs, NFS, overlay): they have no block queue to count
+bool disk_stats(dev_t dev, DiskStats& s) {
+    if (major(dev) == 0) return false;
+    std::ifstream in("/sys/dev/block/" + std::to_string(major(dev)) + ":" + std::to_string(minor(dev)) + "/stat");
+    uint64_t merges;
+    return static_cast<bool>(in >> s.reads >> merges >> s.sectors >> s.read_ms);
+}
+
+// the kernel needs root for this, false otherwise
+bool drop_caches() {
+    ::sync();
+    int fd = ::open("/proc/sys/vm/drop_caches", O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool ok = ::write(fd, "3", 1) == 1;
+    ::close(fd);
+    return ok;
+}
+
+bool is_tmpfs(const fs::path& p) {
+    struct statfs st;
+    return ::statfs(p.c_str(), &st) == 0 && st.f_type == TMPFS_MAGIC;
+}
+
+std::vector<std::string> split(const std::string& s, char sep) {
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, sep)) {
+        if (!item.empty()) out.push_back(item);
+    }
+    return out;
+}
+
+double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+int main(int argc, char* argv[]) {
+    TreeSpec spec;
+    std::vector<std::string> engines = {"cpp_fd", "cpp_fd2", "cpp_fd3", "cpp_fd4", "cpp_fd4 --hdd"};
+    std::vector<int> thread_counts = {1, 2, 4, static_cast<int>(std::thread::hardware_concurrency())};
+    std::vector<std::string> where = {"tmpfs", "disk"};
+    std::string tmpfs_dir = "/dev/shm";
+    std::string disk_dir = "/var/tmp";
+    std::string pattern = "*.c";
+    int repeat = 3;
+    bool syscalls = false;
+    bool keep = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--fanout" && has_value) {
+            spec.fanout = std::stoi(argv[++i]);
+        } else if (arg == "--depth" && has_value) {
+            spec.depth = std::stoi(argv[++i]);
+        } else if (arg == "--files" && has_value) {
+            spec.files = std::stoi(argv[++i]);
+        } else if (arg == "--name-len" && has_value) {
+            // MIN:MAX
+            auto parts = split(argv[++i], ':');
+            spec.name_min = std::stoi(parts.at(0));
+            spec.name_max = parts.size() > 1 ? std::stoi(parts[1]) : spec.name_min;
+        } else if (arg == "--ignore-density" && has_value) {
+            spec.ignore_density = std::stod(argv[++i]);
+        } else if (arg == "--seed" && has_value) {
+            spec.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--engines" && has_value) {
+            engines = split(argv[++i], ',');
+        } else if (arg == "--threads" && has_value) {
+            thread_counts.clear();
+            for (auto& t : split(argv[++i], ',')) thread_counts.push_back(std::stoi(t));
+        } else if (arg == "--where" && has_value) {
+            where = split(argv[++i], ',');
+        } else if (arg == "--tmpfs-dir" && has_value) {
+            tmpfs_dir = argv[++i];
+        } else if (arg == "--disk-dir" && has_value) {
+            disk_dir = argv[++i];
+        } else if (arg == "--pattern" && has_value) {
+            pattern = argv[++i];
+        } else if (arg == "--repeat" && has_value) {
+            repeat = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--syscalls") {
+            syscalls = true;
+        } else if (arg == "--keep") {
+            keep = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--fanout N] [--depth N] [--files N] [--name-len MIN:MAX]"
+                      << " [--ignore-density F] [--seed N] [--engines a,b] [--threads 1,4,8]"
+                      << " [--where tmpfs,disk] [--tmpfs-dir DIR] [--disk-dir DIR] [--pattern GLOB]"
+                      << " [--repeat N] [--syscalls] [--keep]\n";
+            return 1;
+        }
+    }
+    std::sort(thread_counts.begin(), thread_counts.end());
+    thread_counts.erase(std::unique(thread_counts.begin(), thread_counts.end()), thread_counts.end());
+
+    // engines are looked up next to this binary unless given as a path
+    fs::path self_dir = fs::read_symlink("/proc/self/exe").parent_path();
+
+    json out;
+    out["tree"] = {
+        {"fanout", spec.fanout}, {"depth", spec.depth}, {"files_per_dir", spec.files},
+        {"name_min", spec.name_min}, {"name_max", spec.name_max},
+        {"ignore_density", spec.ignore_density}, {"seed", spec.seed},
+    };
+    out["pattern"] = pattern;
+    out["repeat"] = repeat;
+    bool cold_ok = drop_caches();
+    out["cold_cache"] = cold_ok ? "dropped" : "skipped, /proc/sys/vm/drop_caches is not writable";
+    out["results"] = json::array();
+
+    for (const auto& loc : where) {
+        fs::path base = loc == "tmpfs" ? tmpfs_dir : loc == "disk" ? disk_dir : loc;
+        if (loc == "tmpfs" && !is_tmpfs(base)) {
+            std::cerr << base << " is not a tmpfs, skipped" << std::endl;
+            continue;
+        }
+        if (loc == "disk" && is_tmpfs(base)) {
+            std::cerr << base << " is a tmpfs, the disk numbers would be tmpfs numbers" << std::endl;
+        }
+        fs::path root = base / ("cpp_fdbench." + std::to_string(::getpid()));
+        TreeStats stats;
+        std::cerr << "generating " << root << std::endl;
+        if (!TreeGenerator(spec).generate(root, stats)) return 1;
+        uint64_t entries = stats.dirs - 1 + stats.files;  // the root itself is not an entry
+        out["trees"][loc] = {{"path", root.native()}, {"dirs", stats.dirs}, {"files", stats.files},
+                             {"ignore_files", stats.ignore_files}, {"entries", entries}};
+        struct stat root_st;
+        dev_t dev = ::stat(root.c_str(), &root_st) == 0 ? root_st.st_dev : 0;
+
+        for (const auto& engine : engines) {
+            // the binary, then the engine's own flags
+            std::vector<std::string> spec_args = split(engine, ' ');
+            if (spec_args.empty()) continue;
+            fs::path exe = spec_args[0].find('/') == std::string::npos ? self_dir / spec_args[0] : fs::path(spec_args[0]);
+            std::string binary = exe.filename().native();
+            std::string name = binary;
+            for (size_t a = 1; a < spec_args.size(); ++a) name += " " + spec_args[a];
+            // cpp_fd and cpp_fd2 are the single threaded recursive versions
+            bool threaded = binary != "cpp_fd" && binary != "cpp_fd2";
+            std::vector<int> counts = threaded ? thread_counts : std::vector<int>{1};
+
+            for (int threads : counts) {
+                std::vector<std::string> args = {exe.native(), pattern, root.native()};
+                args.insert(args.end(), spec_args.begin() + 1, spec_args.end());
+                if (threaded) {
+                    args.push_back("--threads");
+                    args.push_back(std::to_string(threads));
+                }
+                for (const char* cache : {"warm", "cold"}) {
+                    bool cold = std::strcmp(cache, "cold") == 0;
+                    if (cold && !cold_ok) continue;
+                    if (!cold) run_once(args);  // fill the caches
+
+                    std::vector<double> walls;
+                    long peak_rss = 0;
+                    int exit_code = 0;
+                    DiskStats disk_total;
+                    bool has_disk = false;
+                    for (int r = 0; r < repeat; ++r) {
+                        if (cold) drop_caches();
+                        DiskStats before, after;
+                        bool counted = disk_stats(dev, before);
+                        RunResult res = run_once(args);
+                        if (counted && disk_stats(dev, after)) {
+                            // other processes on the same disk show up here too
+                            has_disk = true;
+                            disk_total.reads += after.reads - before.reads;
+                            disk_total.sectors += after.sectors - before.sectors;
+                            disk_total.read_ms += after.read_ms - before.read_ms;
+                        }
+                        walls.push_back(res.wall_ms);
+                        peak_rss = std::max(peak_rss, res.peak_rss_kb);
+                        if (res.exit_code != 0) exit_code = res.exit_code;
+                    }
+                    double med = median(walls);
+                    json row = {
+                        {"location", loc}, {"engine", name}, {"threads", threads}, {"cache", cache},
+                        {"wall_ms", {{"min", *std::min_element(walls.begin(), walls.end())}, {"median", med}}},
+                        {"entries_per_sec", med > 0 ? entries / (med / 1000.0) : 0.0},
+                        {"peak_rss_kb", peak_rss}, {"exit_code", exit_code},
+                    };
+                    // warm runs should read nothing, the numbers only mean something cold
+                    if (cold && has_disk) {
+                        row["disk"] = {{"reads", disk_total.reads / repeat},
+                                       {"sectors", disk_total.sectors / repeat},
+                                       {"read_ms", disk_total.read_ms / repeat}};
+                    }
+                    // syscalls do not depend on the cache state, counted once per engine and thread count
+                    if (syscalls && !cold) {
+                        std::map<long, uint64_t> calls;
+                        row["syscalls"] = count_syscalls(args, calls) ? syscall_json(calls) : json(nullptr);
+                    }
+                    std::cerr << loc << " " << name << " threads=" << threads << " " << cache
+                              << " " << med << " ms" << std::endl;
+                    out["results"].push_back(std::move(row));
+                }
+            }
+        }
+        if (!keep) {
+            std::error_code ec;
+            fs::remove_all(root, ec);
+        }
+    }
+
+    std::cout << out.dump(2) << '\n';
+    return 0;
+}
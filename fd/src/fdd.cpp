@@ -0,0 +1,512 @@
+/**
+ * cpp_fdd: long running index daemon for the fd tools.
+ *
+ * cpp_fdd <directory> [--socket PATH] [--threads N] [--rescan-interval S]
+ *   walks directory once with the fd4 thread pool traversal, then keeps an in-memory path index
+ *   current from inotify events and answers queries on a Unix socket.
+ * cpp_fdd --query <pattern> [--socket PATH] [--case-sensitive]
+ *   sends one query to a running daemon and prints the matches.
+ *
+ * Protocol: the client sends "<case_sensitive 0|1> <glob>\n", the daemon answers with one path per
+ * line and closes the connection. Connections are served on their own small thread pool, a client
+ * that has not sent its request line within 5 seconds is dropped.
+ *
+ * Directories that could not be watched (inotify watch limit reached, ENOSPC) are remembered and
+ * refreshed every --rescan-interval seconds. After an inotify queue overflow (IN_Q_OVERFLOW) every
+ * directory is checked: only those whose mtime changed are read again.
+ */
+
+#include <iostream>
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <csignal>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <re2/re2.h>
+
+#include "net/threadpool.h"
+#include "net/socket.h"
+#include "gutils.h"
+#include "dirreader.h"
+#include "gitignore.h"
+#include "namematcher.h"
+
+namespace fs = std::filesystem;
+using std::unique_ptr;
+using std::make_unique;
+
+static std::atomic<bool> g_stop{false};
+
+static void on_signal(int) { g_stop.store(true); }
+
+std::string join_path(const std::string& dir, std::string_view name) {
+    std::string p = dir;
+    if (p.empty() || p.back() != '/') p += '/';
+    p += name;
+    return p;
+}
+
+// In-memory index: every directory by full path with the names it contains.
+// Readers (queries) take a shared lock, the walk and the inotify thread an exclusive one.
+class PathIndex {
+    struct DirNode {
+        int wd = -1;                     // inotify watch, -1 when the watch could not be added
+        struct timespec mtime{};
+        std::unordered_map<std::string, unsigned char> children;  // name -> d_type
+        gutils::IgnoreStack ignore;      // .gitignore rules in effect inside this directory
+    };
+
+    std::unordered_map<std::string, DirNode> dirs;
+    std::unordered_map<int, std::string> wd_to_dir;
+    std::unordered_set<std::string> unwatched;
+    mutable std::shared_mutex m;
+
+    int inotify_fd;
+
+    static constexpr uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                           IN_DELETE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW;
+
+public:
+    explicit PathIndex(int fd) : inotify_fd(fd) {}
+
+    // Read one directory and store it, the watch is added before reading so no event is lost.
+    // Returns the subdirectories found, the caller decides how to visit them;
+    // ignore receives the rules to pass down to them.
+    std::vector<std::string> load_dir(const std::string& dir, const gutils::IgnoreStack& parent_ignore,
+                                      gutils::IgnoreStack& ignore, gutils::DirReader& reader) {
+        std::vector<std::string> subdirs;
+        DirNode node;
+        node.wd = inotify_add_watch(inotify_fd, dir.c_str(), kWatchMask);
+        int watch_errno = node.wd < 0 ? errno : 0;
+
+        struct stat st;
+        if (::stat(dir.c_str(), &st) == 0) node.mtime = st.st_mtim;
+
+        if (!reader.open(dir.c_str())) {
+            std::cerr << "Error accessing " << dir << ": " << std::strerror(reader.error()) << std::endl;
+            if (node.wd >= 0) inotify_rm_watch(inotify_fd, node.wd);
+            ignore = parent_ignore;
+            return subdirs;
+        }
+        ignore = gutils::IgnoreNode::enter(reader.fd(), dir, parent_ignore);
+        node.ignore = ignore;
+        gutils::DirEntry entry;
+        while (reader.next(entry)) {
+            std::string child = join_path(dir, entry.name);
+            unsigned char type = reader.resolve_type(entry);
+            if (gutils::is_ignored(ignore, child, type == DT_DIR)) continue;
+            node.children.emplace(std::string(entry.name), type);
+            if (type == DT_DIR) subdirs.push_back(std::move(child));
+        }
+        reader.close();
+
+        std::unique_lock<std::shared_mutex> lock(m);
+        if (node.wd >= 0) {
+            wd_to_dir[node.wd] = dir;
+            unwatched.erase(dir);
+        } else {
+            if (watch_errno == ENOSPC && unwatched.empty()) {
+                std::cerr << "inotify watch limit reached, unwatched directories are rescanned periodically" << std::endl;
+            }
+            unwatched.insert(dir);
+        }
+        dirs[dir] = std::move(node);
+        return subdirs;
+    }
+
+    // Single threaded walk of a subtree, used for directories created or moved in after the initial walk
+    void scan_subtree(const std::string& dir) {
+        gutils::DirReader reader;
+        std::vector<std::pair<std::string, gutils::IgnoreStack>> stack;
+        stack.emplace_back(dir, parent_ignore_of(dir));
+        while (!stack.empty()) {
+            auto [d, parent_ignore] = std::move(stack.back());
+            stack.pop_back();
+            gutils::IgnoreStack ignore;
+            for (auto& sub : load_dir(d, parent_ignore, ignore, reader)) stack.emplace_back(std::move(sub), ignore);
+        }
+    }
+
+    void remove_subtree(const std::string& dir) {
+        std::unique_lock<std::shared_mutex> lock(m);
+        remove_subtree_locked(dir);
+    }
+
+    void add_name(int wd, std::string_view name, bool is_dir) {
+        std::string child;
+        {
+            std::unique_lock<std::shared_mutex> lock(m);
+            auto it = wd_to_dir.find(wd);
+            if (it == wd_to_dir.end()) return;
+            child = join_path(it->second, name);
+            DirNode& node = dirs[it->second];
+            if (gutils::is_ignored(node.ignore, child, is_dir)) return;
+            node.children[std::string(name)] = is_dir ? DT_DIR : DT_REG;
+        }
+        if (is_dir) scan_subtree(child);
+    }
+
+    void remove_name(int wd, std::string_view name, bool is_dir) {
+        std::unique_lock<std::shared_mutex> lock(m);
+        auto it = wd_to_dir.find(wd);
+        if (it == wd_to_dir.end()) return;
+        dirs[it->second].children.erase(std::string(name));
+        if (is_dir) remove_subtree_locked(join_path(it->second, name));
+    }
+
+    // the kernel dropped the watch (directory deleted or unmounted)
+    void forget_watch(int wd) {
+        std::unique_lock<std::shared_mutex> lock(m);
+        auto it = wd_to_dir.find(wd);
+        if (it == wd_to_dir.end()) return;
+        auto dit = dirs.find(it->second);
+        if (dit != dirs.end() && dit->second.wd == wd) dit->second.wd = -1;
+        wd_to_dir.erase(it);
+    }
+
+    // Re-read dir only if its mtime changed: removed subdirectories are dropped, new ones scanned.
+    void refresh_dir(const std::string& dir) {
+        struct stat st;
+        if (::stat(dir.c_str(), &st) != 0) {
+            remove_subtree(dir);
+            return;
+        }
+        std::unordered_map<std::string, unsigned char> old_children;
+        {
+            std::shared_lock<std::shared_mutex> lock(m);
+            auto it = dirs.find(dir);
+            if (it == dirs.end()) return;
+            if (it->second.mtime.tv_sec == st.st_mtim.tv_sec &&
+                it->second.mtime.tv_nsec == st.st_mtim.tv_nsec) {
+                return;
+            }
+            old_children = it->second.children;
+        }
+
+        {
+            // keep the old watch, load_dir adds a new one (inotify returns the same wd for the same inode)
+            gutils::DirReader reader;
+            gutils::IgnoreStack ignore;
+            load_dir(dir, parent_ignore_of(dir), ignore, reader);
+        }
+        std::vector<std::string> added, removed;
+        {
+            std::shared_lock<std::shared_mutex> lock(m);
+            const auto& now = dirs[dir].children;
+            for (const auto& [name, type] : now) {
+                auto it = old_children.find(name);
+                if (type == DT_DIR && (it == old_children.end() || it->second != DT_DIR)) {
+                    added.push_back(join_path(dir, name));
+                }
+            }
+            for (const auto& [name, type] : old_children) {
+                auto it = now.find(name);
+                if (type == DT_DIR && (it == now.end() || it->second != DT_DIR)) {
+                    removed.push_back(join_path(dir, name));
+                }
+            }
+        }
+        for (const auto& d : removed) remove_subtree(d);
+        for (const auto& d : added) scan_subtree(d);
+    }
+
+    // after IN_Q_OVERFLOW events may be missing anywhere, checking mtimes is still far cheaper than a walk
+    void refresh_all() {
+        std::vector<std::string> all;
+        {
+            std::shared_lock<std::shared_mutex> lock(m);
+            all.reserve(dirs.size());
+            for (const auto& kv : dirs) all.push_back(kv.first);
+        }
+        for (const auto& d : all) refresh_dir(d);
+    }
+
+    // directories without a watch only see changes through polling
+    void refresh_unwatched() {
+        std::vector<std::string> todo;
+        {
+            std::shared_lock<std::shared_mutex> lock(m);
+            todo.assign(unwatched.begin(), unwatched.end());
+        }
+        for (const auto& d : todo) {
+            // the limit may have been raised or watches freed in the meantime
+            int wd = inotify_add_watch(inotify_fd, d.c_str(), kWatchMask);
+            if (wd >= 0) {
+                std::unique_lock<std::shared_mutex> lock(m);
+                auto it = dirs.find(d);
+                if (it == dirs.end()) {
+                    inotify_rm_watch(inotify_fd, wd);
+                    continue;
+                }
+                it->second.wd = wd;
+                wd_to_dir[wd] = d;
+                unwatched.erase(d);
+            }
+            refresh_dir(d);
+        }
+    }
+
+    std::string query(const gutils::NameMatcher& pattern) const {
+        std::string out;
+        std::shared_lock<std::shared_mutex> lock(m);
+        for (const auto& [dir, node] : dirs) {
+            for (const auto& [name, type] : node.children) {
+                if (pattern.matches(name)) {
+                    out += join_path(dir, name);
+                    out += '\n';
+                }
+            }
+        }
+        return out;
+    }
+
+    size_t dir_count() const {
+        std::shared_lock<std::shared_mutex> lock(m);
+        return dirs.size();
+    }
+
+private:
+    // rules in effect for the parent of dir, nullptr for the root
+    gutils::IgnoreStack parent_ignore_of(const std::string& dir) const {
+        std::string parent = fs::path(dir).parent_path().string();
+        std::shared_lock<std::shared_mutex> lock(m);
+        auto it = dirs.find(parent);
+        return it == dirs.end() ? nullptr : it->second.ignore;
+    }
+
+    void remove_subtree_locked(const std::string& dir) {
+        auto it = dirs.find(dir);
+        if (it == dirs.end()) return;
+        for (const auto& [name, type] : it->second.children) {
+            if (type == DT_DIR) remove_subtree_locked(join_path(dir, name));
+        }
+        it = dirs.find(dir);
+        if (it->second.wd >= 0) {
+            inotify_rm_watch(inotify_fd, it->second.wd);
+            wd_to_dir.erase(it->second.wd);
+        }
+        unwatched.erase(dir);
+        dirs.erase(it);
+    }
+};
+
+// Initial walk, same shape as fd_search_threaded in fd4: one pool task per directory
+void index_threaded(
+    const std::string& dir,
+    const gutils::IgnoreStack& parent_ignore,
+    PathIndex& index,
+    ThreadPool& pool,
+    std::atomic<int>& active_tasks
+) {
+    thread_local gutils::DirReader reader;
+    gutils::IgnoreStack ignore;
+    for (auto& subdir : index.load_dir(dir, parent_ignore, ignore, reader)) {
+        active_tasks.fetch_add(1, std::memory_order_relaxed);
+        pool.enqueue(index_threaded, std::move(subdir), ignore, std::ref(index), std::ref(pool), std::ref(active_tasks));
+    }
+    active_tasks.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void watch_loop(int inotify_fd, PathIndex& index, int rescan_interval) {
+    alignas(struct inotify_event) char buf[64 * 1024];
+    auto last_rescan = std::chrono::steady_clock::now();
+
+    while (!g_stop.load()) {
+        pollfd pfd{inotify_fd, POLLIN, 0};
+        int r = ::poll(&pfd, 1, 1000);
+
+        if (r > 0) {
+            ssize_t len = ::read(inotify_fd, buf, sizeof(buf));
+            for (ssize_t off = 0; off < len;) {
+                auto* ev = reinterpret_cast<struct inotify_event*>(buf + off);
+                off += sizeof(struct inotify_event) + ev->len;
+
+                if (ev->mask & IN_Q_OVERFLOW) {
+                    std::cerr << "inotify queue overflow, checking directory mtimes" << std::endl;
+                    index.refresh_all();
+                    continue;
+                }
+                bool is_dir = ev->mask & IN_ISDIR;
+                std::string_view name = ev->len ? std::string_view(ev->name) : std::string_view();
+                if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    index.add_name(ev->wd, name, is_dir);
+                } else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    index.remove_name(ev->wd, name, is_dir);
+                } else if (ev->mask & IN_IGNORED) {
+                    index.forget_watch(ev->wd);
+                }
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_rescan >= std::chrono::seconds(rescan_interval)) {
+            index.refresh_unwatched();
+            last_rescan = now;
+        }
+    }
+}
+
+// a client has this long to send its request line, and each send of the answer this long to go out
+constexpr int kClientTimeoutMs = 5000;
+// connections served at once. most of a connection is waiting on the client, not on a CPU, so this
+// does not follow --threads: several stalled clients still leave threads for the others
+constexpr size_t kClientThreads = 8;
+
+// one connection, on a pool thread: a client that stalls holds up its own thread for the timeout at
+// most, never the accept loop or the other clients
+void serve_client(const std::shared_ptr<Socket>& client, const PathIndex& index) {
+    timeval send_timeout{kClientTimeoutMs / 1000, (kClientTimeoutMs % 1000) * 1000};
+    ::setsockopt(client->get(), SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+
+    // one deadline for the whole line, a client sending a byte at a time does not extend it
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kClientTimeoutMs);
+    std::string request;
+    char buf[4096];
+    while (request.find('\n') == std::string::npos) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        pollfd pfd{client->get(), POLLIN, 0};
+        if (left.count() <= 0 || ::poll(&pfd, 1, static_cast<int>(left.count())) <= 0) return;
+        ssize_t n = client->recv_some(buf, sizeof(buf));
+        if (n <= 0) return;
+        request.append(buf, static_cast<size_t>(n));
+    }
+    size_t nl = request.find('\n');
+    if (nl < 2) return;
+    request.resize(nl);
+
+    gutils::NameMatcher pattern(std::string_view(request).substr(2), request[0] == '1');
+    if (!pattern.ok()) {
+        std::string err = "Invalid regex pattern: " + pattern.error() + "\n";
+        client->send_all(err.data(), err.size());
+        return;
+    }
+    std::string out = index.query(pattern);
+    client->send_all(out.data(), out.size());
+}
+
+void serve(Socket& server, const PathIndex& index) {
+    // joined before serve returns, every client task ends within its timeouts
+    ThreadPool clients(kClientThreads);
+    while (!g_stop.load()) {
+        Socket client = server.accept();
+        if (!client.is_valid()) continue;  // EINTR on shutdown
+        // the pool's tasks are std::function, they have to be copyable
+        clients.enqueue(serve_client, std::make_shared<Socket>(std::move(client)), std::cref(index));
+    }
+}
+
+int run_query(const std::string& socket_path, const std::string& pattern, bool case_sensitive) {
+    Socket sock;
+    if (!sock.create(AF_UNIX) || !sock.connect_unix(socket_path)) {
+        std::cerr << "Cannot connect to " << socket_path << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    std::string request = std::string(case_sensitive ? "1 " : "0 ") + pattern + "\n";
+    if (sock.send_all(request.data(), request.size()) < 0) {
+        std::cerr << "Cannot send query: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    char buf[64 * 1024];
+    ssize_t n;
+    while ((n = sock.recv_some(buf, sizeof(buf))) > 0) {
+        std::cout.write(buf, n);
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <directory> [--socket PATH] [--threads N] [--rescan-interval S]\n"
+                  << "       " << argv[0] << " --query <pattern> [--socket PATH] [--case-sensitive]\n";
+        return 1;
+    }
+
+    std::string socket_path = "/tmp/cpp_fdd.sock";
+    std::string query;
+    bool case_sensitive = false;
+    int num_threads = std::thread::hardware_concurrency();
+    int rescan_interval = 30;
+    std::string dir;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--query" && i + 1 < argc) {
+            query = argv[++i];
+        } else if (arg == "--socket" && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (arg == "--case-sensitive") {
+            case_sensitive = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            num_threads = std::stoi(argv[++i]);
+        } else if (arg == "--rescan-interval" && i + 1 < argc) {
+            rescan_interval = std::stoi(argv[++i]);
+        } else if (dir.empty()) {
+            dir = arg;
+        }
+    }
+
+    if (!query.empty()) {
+        return run_query(socket_path, query, case_sensitive);
+    }
+    if (dir.empty()) dir = ".";
+    if (dir.size() > 1 && dir.back() == '/') dir.pop_back();
+    if (num_threads < 1) num_threads = 1;
+    if (rescan_interval < 1) rescan_interval = 1;
+
+    // no SA_RESTART: a blocking accept() returns with EINTR so the loops see g_stop
+    struct sigaction sa{};
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        std::cerr << "inotify_init1 failed: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    PathIndex index(inotify_fd);
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    {
+      ThreadPool pool(num_threads);
+      std::atomic<int> active_tasks(1);
+      index_threaded(dir, nullptr, index, pool, active_tasks);
+      while (active_tasks.load() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - start_time);
+    std::cerr << "Indexed " << index.dir_count() << " directories in " << duration.count()
+              << " ms using " << num_threads << " threads" << std::endl;
+
+    Socket server;
+    if (!server.create(AF_UNIX) || !server.bind_unix(socket_path) || !server.listen(64)) {
+        std::cerr << "Cannot listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    std::cerr << "Listening on " << socket_path << std::endl;
+
+    std::thread watcher(watch_loop, inotify_fd, std::ref(index), rescan_interval);
+    serve(server, index);
+
+    watcher.join();
+    server.close();
+    ::unlink(socket_path.c_str());
+    ::close(inotify_fd);
+    return 0;
+}
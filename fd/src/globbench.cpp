@@ -0,0 +1,258 @@
+/**
+ * Benchmark for the native glob engine against the RE2 path it replaced.
+ * Name patterns: compile time and match time per name, Glob vs RE2 on glob_to_re2.
+ * Ignore rules: a .gitignore of typical rules, padded with generated gen_N_*.tmp rules to 200
+ * and 2000 rules, IgnoreNode (one RE2::Set of glob_to_re2) vs one Glob program per rule, last
+ * matching rule wins in both. Every row also says whether both sides agreed on every input. JSON on stdout.
+ *
+ * cpp_globbench --names 1000000 --seed 42 > glob.json
+ * cpp_globbench --pattern '*.{c,h}' --pattern 'file[0-9]*'
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <re2/re2.h>
+#include <nlohmann/json.hpp>
+
+#include "glob.h"
+#include "gitignore.h"
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+// names like the ones cpp_fdbench generates, plus some upper case and digits
+std::vector<std::string> make_names(size_t count, uint32_t seed) {
+    static const char* kExt[] = {".txt", ".c", ".h", ".cpp", ".log", ".tmp", ".json", ".md", ".o", ""};
+    static const char kChars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-";
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> len(3, 20);
+    std::uniform_int_distribution<size_t> ch(0, sizeof(kChars) - 2);
+    std::uniform_int_distribution<size_t> ext(0, std::size(kExt) - 1);
+    std::vector<std::string> names;
+    names.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string s;
+        for (int n = len(rng); n > 0; --n) s += kChars[ch(rng)];
+        names.push_back(s + kExt[ext(rng)]);
+    }
+    return names;
+}
+
+// relative paths 1 to 5 components deep, some through directories the rules name
+std::vector<std::string> make_paths(const std::vector<std::string>& names, uint32_t seed) {
+    static const char* kDirs[] = {"src", "build", "node_modules", "docs", "lib", "test", "out", "vendor", "a", "b"};
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> depth(0, 4);
+    std::uniform_int_distribution<size_t> dir(0, std::size(kDirs) - 1);
+    std::vector<std::string> paths;
+    paths.reserve(names.size());
+    for (const auto& name : names) {
+        std::string p;
+        for (int d = depth(rng); d > 0; --d) p += std::string(kDirs[dir(rng)]) + "/";
+        paths.push_back(p + name);
+    }
+    return paths;
+}
+
+template <typename F>
+double ns_per(size_t n, F&& f) {
+    auto start = Clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / std::max<size_t>(n, 1);
+}
+
+json bench_pattern(const std::string& pattern, const std::vector<std::string>& names, int compiles) {
+    gutils::GlobOptions options;
+    options.case_sensitive = false;  // fd's default
+    RE2::Options re2_options;
+    re2_options.set_case_sensitive(false);
+    std::string regex = "^(?:" + gutils::glob_to_re2(pattern, options) + ")$";
+
+    double glob_compile = ns_per(compiles, [&] {
+        for (int i = 0; i < compiles; ++i) gutils::Glob g(pattern, options);
+    });
+    double re2_compile = ns_per(compiles, [&] {
+        for (int i = 0; i < compiles; ++i) RE2 r(regex, re2_options);
+    });
+
+    gutils::Glob glob(pattern, options);
+    RE2 re2(regex, re2_options);
+    size_t glob_hits = 0, re2_hits = 0, disagree = 0;
+    double glob_match = ns_per(names.size(), [&] {
+        for (const auto& n : names) glob_hits += glob.matches(n);
+    });
+    double re2_match = ns_per(names.size(), [&] {
+        for (const auto& n : names) re2_hits += RE2::PartialMatch(n, re2);
+    });
+    for (const auto& n : names) disagree += glob.matches(n) != RE2::PartialMatch(n, re2);
+
+    std::cerr << pattern << ": glob " << glob_match << " ns, re2 " << re2_match << " ns per name" << std::endl;
+    return {
+        {"pattern", pattern}, {"regex", regex}, {"program_size", glob.program_size()},
+        {"compile_ns", {{"glob", glob_compile}, {"re2", re2_compile}}},
+        {"match_ns", {{"glob", glob_match}, {"re2", re2_match}}},
+        {"matches", glob_hits}, {"agree", disagree == 0 && glob_hits == re2_hits}, {"disagreements", disagree},
+    };
+}
+
+// the Glob side of the ignore benchmark: one Glob program per rule, tried from the last one back.
+// IgnoreNode puts the same rules, through glob_to_re2, into one RE2::Set
+class GlobIgnore {
+public:
+    explicit GlobIgnore(const std::string& text) {
+        gutils::GlobOptions options;
+        options.path = true;
+        options.braces = false;
+        size_t pos = 0;
+        while (pos < text.size()) {
+            size_t nl = text.find('\n', pos);
+            std::string line = text.substr(pos, nl - pos);
+            pos = nl == std::string::npos ? text.size() : nl + 1;
+            if (line.empty() || line[0] == '#') continue;
+            bool negate = line[0] == '!';
+            if (negate) line.erase(0, 1);
+            bool dir_only = !line.empty() && line.back() == '/';
+            if (dir_only) line.pop_back();
+            if (line.empty()) continue;
+            bool anchored = line.find('/') != std::string::npos;
+            if (line[0] == '/') line.erase(0, 1);
+            rules_.push_back({negate, dir_only, !anchored, gutils::Glob(line, options)});
+        }
+    }
+
+    bool is_ignored(const std::string& rel, bool is_dir) const {
+        size_t slash = rel.rfind('/');
+        std::string_view name = slash == std::string::npos ? std::string_view(rel) : std::string_view(rel).substr(slash + 1);
+        for (size_t i = rules_.size(); i-- > 0;) {
+            const Rule& rule = rules_[i];
+            if (rule.dir_only && !is_dir) continue;
+            if (rule.glob.matches(rule.basename ? name : std::string_view(rel))) return !rule.negate;
+        }
+        return false;
+    }
+
+private:
+    struct Rule {
+        bool negate;
+        bool dir_only;
+        bool basename;  // no '/' in the pattern: the last component only
+        gutils::Glob glob;
+    };
+    std::vector<Rule> rules_;
+};
+
+// rules: the total, the typical ones padded with generated ones. every 10th path gets a generated
+// name, half of them covered by a rule
+json bench_ignore(std::vector<std::string> paths, size_t rules, int compiles, uint32_t seed) {
+    static const char kRules[] =
+        "# typical rules\n*.o\n*.log\n*.tmp\nbuild/\nnode_modules/\n/out\n*.swp\n.DS_Store\n"
+        "docs/**/*.md\n**/vendor/**\nlib/*.a\n!keep.log\n*.[oa]\ntest/fixture[0-9]*\n*~\n"
+        "src/**/gen_*.c\ncoverage/\n*.py[cod]\n__pycache__/\n";
+    static constexpr size_t kTypical = 20;
+    const std::string base = "/bench";
+    std::string text = kRules;
+    size_t generated = rules > kTypical ? rules - kTypical : 0;
+    for (size_t i = 0; i < generated; ++i) {
+        // the generated ones are .tmp, keep some of them with a negation so the order matters
+        text += (i % 16 == 15 ? "!gen_" : "gen_") + std::to_string(i) + "_*.tmp\n";
+    }
+    if (generated > 0) {
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<size_t> pick(0, 2 * generated - 1);
+        for (size_t i = 0; i < paths.size(); i += 10) {
+            size_t slash = paths[i].rfind('/');
+            size_t at = slash == std::string::npos ? 0 : slash + 1;
+            paths[i] = paths[i].substr(0, at) + "gen_" + std::to_string(pick(rng)) + "_" + paths[i].substr(at) + ".tmp";
+        }
+    }
+    // a set of thousands of rules takes milliseconds to build, fewer rounds for those
+    compiles = std::max<int>(1, static_cast<int>(compiles * kTypical / std::max(rules, kTypical)));
+
+    double node_compile = ns_per(compiles, [&] {
+        for (int i = 0; i < compiles; ++i) gutils::IgnoreNode::from_text(text, base, nullptr);
+    });
+    double glob_compile = ns_per(compiles, [&] {
+        for (int i = 0; i < compiles; ++i) GlobIgnore g(text);
+    });
+
+    gutils::IgnoreStack node = gutils::IgnoreNode::from_text(text, base, nullptr);
+    GlobIgnore globs(text);
+    std::vector<std::string> full;
+    full.reserve(paths.size());
+    for (const auto& p : paths) full.push_back(base + "/" + p);
+
+    // the agreement check first: it also warms up the lazily built DFA of the set, so the timing
+    // is the steady state of a long walk and not the first paths building the states
+    size_t node_hits = 0, glob_hits = 0, disagree = 0;
+    for (size_t i = 0; i < paths.size(); ++i) disagree += node->is_ignored(full[i], false) != globs.is_ignored(paths[i], false);
+    double node_match = ns_per(paths.size(), [&] {
+        for (const auto& p : full) node_hits += node->is_ignored(p, false);
+    });
+    double glob_match = ns_per(paths.size(), [&] {
+        for (const auto& p : paths) glob_hits += globs.is_ignored(p, false);
+    });
+
+    std::cerr << "gitignore, " << std::max(rules, kTypical) << " rules: ignore node " << node_match
+              << " ns, glob per rule " << glob_match << " ns per path" << std::endl;
+    return {
+        {"rules", std::max(rules, kTypical)},
+        {"compile_ns", {{"ignore_node", node_compile}, {"glob_per_rule", glob_compile}}},
+        {"match_ns", {{"ignore_node", node_match}, {"glob_per_rule", glob_match}}},
+        {"ignored", node_hits}, {"agree", disagree == 0 && node_hits == glob_hits}, {"disagreements", disagree},
+    };
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = 1000000;
+    uint32_t seed = 42;
+    int compiles = 1000;
+    std::vector<std::string> patterns;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--names" && has_value) {
+            count = std::stoull(argv[++i]);
+        } else if (arg == "--seed" && has_value) {
+            seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--compiles" && has_value) {
+            compiles = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--pattern" && has_value) {
+            patterns.push_back(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--names N] [--seed N] [--compiles N] [--pattern GLOB]...\n";
+            return 1;
+        }
+    }
+    // the shapes NameMatcher sends to the engine: the literal ones never get there
+    if (patterns.empty()) {
+        patterns = {"*.{c,h,cpp}", "file[0-9]*.txt", "?[a-f]*_*.log", "*a*b*c*", "[!a-m]*.[ch]",
+                    "[[:upper:]][[:digit:]]*", "*{test,spec}*.json", "a?c*"};
+    }
+
+    std::vector<std::string> names = make_names(count, seed);
+    std::vector<std::string> paths = make_paths(names, seed + 1);
+
+    json out;
+    out["names"] = count;
+    out["seed"] = seed;
+    out["patterns"] = json::array();
+    bool agree = true;
+    for (const auto& p : patterns) {
+        json row = bench_pattern(p, names, compiles);
+        agree = agree && row["agree"].get<bool>();
+        out["patterns"].push_back(std::move(row));
+    }
+    out["gitignore"] = json::array();
+    for (size_t rules : {size_t(20), size_t(200), size_t(2000)}) {
+        json row = bench_ignore(paths, rules, compiles, seed + 2);
+        agree = agree && row["agree"].get<bool>();
+        out["gitignore"].push_back(std::move(row));
+    }
+    std::cout << out.dump(2) << '\n';
+    return agree ? 0 : 1;
+}
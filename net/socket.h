@@ -12,6 +12,7 @@
 #include <functional>
 #include <chrono>
 #include <exception>
+#include <string>
 
 // Platform-specific includes
 /* #ifdef _WIN32 */
@@ -23,6 +24,7 @@
 /*     #define SOCKET_ERROR_CHECK(x) ((x) == SOCKET_ERROR) */
 /* #else */
     #include <sys/socket.h>
+    #include <sys/un.h>
     #include <netinet/in.h>
     #include <arpa/inet.h>
     #include <unistd.h>
@@ -92,6 +94,21 @@ public:
                                          sizeof(addr)));
     }
 
+    // Unix domain socket, create(AF_UNIX) first. a stale socket file is removed
+    bool bind_unix(const std::string& path) {
+        if (sock_ == INVALID_SOCKET) return false;
+
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path)) return false;
+        addr.sun_family = AF_UNIX;
+        path.copy(addr.sun_path, path.size());
+        ::unlink(path.c_str());
+
+        return !SOCKET_ERROR_CHECK(::bind(sock_,
+                                         reinterpret_cast<sockaddr*>(&addr),
+                                         sizeof(addr)));
+    }
+
     bool listen(int backlog = 5) {
         return sock_ != INVALID_SOCKET &&
                !SOCKET_ERROR_CHECK(::listen(sock_, backlog));
@@ -122,6 +139,19 @@ public:
                                            sizeof(addr)));
     }
 
+    bool connect_unix(const std::string& path) {
+        if (sock_ == INVALID_SOCKET) return false;
+
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path)) return false;
+        addr.sun_family = AF_UNIX;
+        path.copy(addr.sun_path, path.size());
+
+        return !SOCKET_ERROR_CHECK(::connect(sock_,
+                                           reinterpret_cast<sockaddr*>(&addr),
+                                           sizeof(addr)));
+    }
+
     // Handle partial sends - CRITICAL for TCP
     ssize_t send_all(const void* data, size_t length) {
         if (sock_ == INVALID_SOCKET) return -1;
@@ -156,6 +186,12 @@ public:
         return received;
     }
 
+    // whatever is available, at most length bytes. 0 when the peer closed
+    ssize_t recv_some(void* buffer, size_t length) {
+        if (sock_ == INVALID_SOCKET) return -1;
+        return recv(sock_, static_cast<char*>(buffer), length, 0);
+    }
+
     void close() {
         if (sock_ != INVALID_SOCKET) {
             CLOSE_SOCKET(sock_);
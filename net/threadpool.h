@@ -58,6 +58,17 @@ public:
     ThreadPool(ThreadPool&&) = delete;
     ThreadPool& operator=(ThreadPool&&) = delete;
 
+    // drop the tasks that have not started yet and return how many there were.
+    // tasks already running are not affected
+    size_t clear() {
+        std::queue<std::function<void()>> dropped;
+        {
+            std::lock_guard<std::mutex> lock(queuemutex);
+            tasks.swap(dropped);
+        }
+        return dropped.size();
+    }
+
     // accept a function and multiple vars
     // able to pass arguments directly (as with std::thread or std::async),
     template<class F, class... Args>